@@ -4,6 +4,8 @@
 #include <mpl/mpl.hpp>
 #include <sstream>
 
+#include "logger.h"
+
 bool tryParse(std::string value, int& result) {
   std::istringstream stream(value);
   if (stream >> result) {
@@ -24,8 +26,18 @@ bool ArgParser::getValue(std::string key, int& value, std::vector<std::string> a
   return false;
 }
 
-Configuration ArgParser::parse(int argc, char** argv) {
-  Configuration configuration;
+bool ArgParser::hasFlag(std::string key, std::vector<std::string> args) {
+  return std::find(args.begin(), args.end(), key) != args.end();
+}
+
+bool ArgParser::getString(std::string key, std::string& value, std::vector<std::string> args) {
+  auto position = std::find(args.begin(), args.end(), key);
+  if (position == args.end() || (++position) == args.end()) return false;
+  value = *position;
+  return true;
+}
+
+Configuration ArgParser::parse(int argc, char** argv, Configuration configuration) {
   std::vector<std::string> args(argv + 1, argv + argc);
   int value;
   if (getValue("-h", value, args)) {
@@ -38,7 +50,22 @@ Configuration ArgParser::parse(int argc, char** argv) {
           "[-l MIN_HAMSTERS_PER_CONTRACT]    minimal number of hamsters to kill per contract\n"
           "[-h MAX_HAMSTERS_PER_CONTRACT]    maximal number of hamsters to kill per contract\n"
           "[-s SWORDS_TOTAL]                 total number of swords available to gnomes\n"
-          "[-p POISON_TOTAL]                 total number of poison kits available to gnomes\n",
+          "[-p POISON_TOTAL]                 total number of poison kits available to gnomes\n"
+          "[-e]                              receive through persistent requests in an event loop\n"
+          "[-c FRAME_BYTES]                  coalesce messages to the same rank into frames of up to FRAME_BYTES\n"
+          "[-t]                              run all MPI traffic on a separate progress thread, not with -e\n"
+          "[-z]                              send messages varint-packed instead of as MPI datatypes\n"
+          "[-a messages|rma|permissions]     armory engine: agreement by messages, one-sided counters\n"
+          "                                  or a ledger guarded by Ricart-Agrawala permissions\n"
+          "[-b]                              publish contract waves in an RMA window instead of sending them\n"
+          "[-n]                              exchange armor requests in a neighborhood collective\n"
+          "[-i]                              send contract waves with a nonblocking broadcast\n"
+          "[-w WINDOW]                       at most WINDOW messages in flight to each peer, 0 = no limit\n"
+          "[-m standard|buffered]            send mode: MPI standard sends or buffered sends from a preallocated buffer\n"
+          "[-o LOG_PREFIX]                   write the log of each rank to LOG_PREFIX<rank>.log instead of stdout\n"
+          "[-v trace|debug|info|warning]     least severe level to log, levels below MIN_LOG_LEVEL are compiled out\n"
+          "[-x TRACE_PREFIX]                 record a binary event trace of each rank in TRACE_PREFIX<rank>.trace\n"
+          "[-d]                              simulate the time hamsters take to kill instead of sleeping, only with -a messages\n",
           argv[0]);
     }
     exit(EXIT_SUCCESS);
@@ -58,5 +85,52 @@ Configuration ArgParser::parse(int argc, char** argv) {
   if (getValue("-p", value, args)) {
     configuration.poisonTotal = value;
   }
+  if (hasFlag("-e", args)) {
+    configuration.eventLoop = true;
+  }
+  if (getValue("-c", value, args)) {
+    configuration.frameBytes = value;
+  }
+  if (hasFlag("-t", args)) {
+    configuration.progressThread = true;
+  }
+  if (hasFlag("-z", args)) {
+    configuration.packedCodec = true;
+  }
+  getString("-a", configuration.armoryEngine, args);
+  if (hasFlag("-b", args)) {
+    configuration.contractBoard = true;
+  }
+  if (hasFlag("-n", args)) {
+    configuration.neighborCollectives = true;
+  }
+  if (hasFlag("-i", args)) {
+    configuration.contractBroadcast = true;
+  }
+  if (getValue("-w", value, args)) {
+    configuration.creditWindow = value;
+  }
+  getString("-m", configuration.sendMode, args);
+  getString("-o", configuration.logPrefix, args);
+  getString("-v", configuration.verbosity, args);
+  LogLevel level;
+  if (!Logger::getLevel(configuration.verbosity, level)) {
+    if (mpl::environment::comm_world().rank() == 0) {
+      fprintf(stderr, "Unknown log level \"%s\", see -h for usage.\n",
+              configuration.verbosity.c_str());
+    }
+    exit(EXIT_FAILURE);
+  }
+  getString("-x", configuration.tracePrefix, args);
+  if (hasFlag("-d", args)) {
+    configuration.virtualTime = true;
+  }
+  // the progress thread owns every receive, there is no event loop to run
+  if (configuration.progressThread && configuration.eventLoop) {
+    if (mpl::environment::comm_world().rank() == 0) {
+      fprintf(stderr, "-t and -e cannot be combined, see -h for usage.\n");
+    }
+    exit(EXIT_FAILURE);
+  }
   return configuration;
 }
@@ -10,14 +10,31 @@ struct Configuration {
   int maxHamstersPerContract = 20;
   int swordsTotal = 5;
   int poisonTotal = 30;
+  bool eventLoop = false;
+  int frameBytes = 0;
+  bool progressThread = false;
+  bool packedCodec = false;
+  std::string armoryEngine = "messages";
+  bool contractBoard = false;
+  bool neighborCollectives = false;
+  bool contractBroadcast = false;
+  int creditWindow = 0;
+  std::string sendMode = "standard";
+  std::string logPrefix;
+  std::string verbosity = "trace";
+  std::string tracePrefix;
+  bool virtualTime = false;
 };
 
 class ArgParser {
  private:
   static bool getValue(std::string key, int& value, std::vector<std::string> args);
+  static bool hasFlag(std::string key, std::vector<std::string> args);
+  static bool getString(std::string key, std::string& value, std::vector<std::string> args);
 
  public:
-  static Configuration parse(int argc, char** argv);
+  static Configuration parse(int argc, char** argv,
+                             Configuration configuration = Configuration());
 };
 
 #endif  // ARG_PARSER_H_
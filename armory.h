@@ -0,0 +1,18 @@
+#ifndef ARMORY_H_
+#define ARMORY_H_
+
+// An engine gnomes take armor from and return it to, used with -a rma or
+// -a permissions. The default message protocol of the armory queue is not
+// one, it runs in the gnome's own states and handlers.
+class Armory {
+ public:
+  virtual ~Armory() = default;
+
+  // takes all of it or nothing, false when the armory is short
+  virtual bool tryAcquire(int swords, int poison) = 0;
+  virtual void release(int swords, int poison) = 0;
+  // point-to-point messages this rank sent for it
+  virtual unsigned long getSentMessages() const { return 0; }
+};
+
+#endif  // ARMORY_H_
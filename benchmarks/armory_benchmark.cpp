@@ -0,0 +1,70 @@
+// Armory allocation latency, from asking for armor until the rampage
+// starts, for the message protocol, the one-sided RMA counters and the
+// Ricart-Agrawala permissions. For the two engines that send messages it
+// also gives the messages a gnome sends to other gnomes to take and return
+// the armor of a contract, against the 2(N-1) of one plain Ricart-Agrawala
+// critical section. Few swords by default so gnomes actually compete for
+// the armory.
+// Run with: mpirun -np 8 armory_benchmark [-r ROUNDS] [-s SWORDS]
+#include <cstdio>
+
+#include "permission_armory.h"
+#include "protocol_benchmark.h"
+#include "rma_armory.h"
+
+namespace {
+
+struct Measurement {
+  double latency;                // mean of the per-gnome averages of gnomes that got work
+  double messagesPerAllocation;  // armory messages between gnomes
+};
+
+// valid on the landlord
+Measurement measureAllocation(const mpl::communicator& world, int rounds) {
+  double latency = 0;
+  unsigned long messages = 0;
+  int allocations = 0;
+  runProtocol(world, rounds, [&](const Gnome& gnome) {
+    latency = gnome.getAverageAllocationLatency();
+    messages = gnome.getArmoryMessages();
+    allocations = gnome.getAllocations();
+  });
+  double sum = 0;
+  int employed = 0;
+  world.reduce(mpl::plus<double>(), Landlord::landlordRank, latency, sum);
+  world.reduce(mpl::plus<int>(), Landlord::landlordRank, latency > 0 ? 1 : 0, employed);
+  unsigned long messageSum = 0;
+  int allocationSum = 0;
+  world.reduce(mpl::plus<unsigned long>(), Landlord::landlordRank, messages, messageSum);
+  world.reduce(mpl::plus<int>(), Landlord::landlordRank, allocations, allocationSum);
+  return Measurement{employed == 0 ? 0 : sum / employed,
+                     allocationSum == 0 ? 0 : static_cast<double>(messageSum) / allocationSum};
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto config = parseOptions(argc, argv, getDefaults(50, 2));
+
+  const mpl::communicator& world(mpl::environment::comm_world());
+  discardProtocolLog();
+
+  auto messageProtocol = measureAllocation(world, config.maxRounds);
+  RmaArmory::enabled = true;
+  auto rma = measureAllocation(world, config.maxRounds);
+  RmaArmory::enabled = false;
+  PermissionArmory::enabled = true;
+  auto permissions = measureAllocation(world, config.maxRounds);
+
+  if (world.rank() == Landlord::landlordRank) {
+    int gnomes = world.size() - 1;
+    fprintf(stderr, "%d gnomes, %d rounds, %d swords, 2(N-1) = %d messages\n", gnomes,
+            config.maxRounds, config.swordsTotal, 2 * (gnomes - 1));
+    fprintf(stderr, "message protocol: %8.3f ms per allocation, %5.1f messages\n",
+            messageProtocol.latency, messageProtocol.messagesPerAllocation);
+    fprintf(stderr, "rma counters:     %8.3f ms per allocation\n", rma.latency);
+    fprintf(stderr, "permissions:      %8.3f ms per allocation, %5.1f messages\n",
+            permissions.latency, permissions.messagesPerAllocation);
+  }
+  return 0;
+}
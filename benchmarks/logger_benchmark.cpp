@@ -0,0 +1,57 @@
+// Cost of logging into per-rank files, once with every record formatted and
+// written by the caller and once through the ring and its flusher thread:
+// time per log call on the calling thread and rounds per second of the full
+// landlord/gnome protocol, which logs every step. -o sets where the logs go.
+// Run with: mpirun -np 8 logger_benchmark [-r ROUNDS] [-o LOG_PREFIX]
+#include <chrono>
+#include <cstdio>
+
+#include "logger.h"
+#include "protocol_benchmark.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const int calls = 200000;
+
+// returns nanoseconds per call, the flusher catches up outside the timing
+double measureCalls(int rank, unsigned long& dropped) {
+  Logger logger(rank, "BENCHMARK");
+  auto start = Clock::now();
+  for (int call = 0; call < calls; call++) {
+    logger.write(call, "Received REQUEST_FOR_ARMOR from GNOME %d, %d hamsters to kill", call % 8,
+                 call);
+  }
+  auto elapsed = Clock::now() - start;
+  dropped = logger.getDroppedRecords();
+  return std::chrono::duration<double, std::nano>(elapsed).count() / calls;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  auto defaults = getDefaults(200, 3);
+  defaults.logPrefix = "/tmp/logger_benchmark_";
+  auto config = parseOptions(argc, argv, defaults);
+  Logger::filePrefix = config.logPrefix;
+
+  const mpl::communicator& world(mpl::environment::comm_world());
+  unsigned long syncDropped, asyncDropped;
+
+  Logger::synchronous = true;
+  double syncCall = measureCalls(world.rank(), syncDropped);
+  double syncRounds = config.maxRounds / runProtocol(world, config.maxRounds);
+  Logger::synchronous = false;
+  double asyncCall = measureCalls(world.rank(), asyncDropped);
+  double asyncRounds = config.maxRounds / runProtocol(world, config.maxRounds);
+
+  if (world.rank() == Landlord::landlordRank) {
+    printf("%d ranks, %d rounds, ring of %zu records\n", world.size(), config.maxRounds,
+           Logger::capacity);
+    printf("%-12s %10s %12s %14s\n", "logging", "ns/call", "rounds/s", "calls dropped");
+    printf("%-12s %10.1f %12.1f %14lu\n", "synchronous", syncCall, syncRounds, syncDropped);
+    printf("%-12s %10.1f %12.1f %14lu\n", "ring", asyncCall, asyncRounds, asyncDropped);
+  }
+  return 0;
+}
@@ -0,0 +1,118 @@
+// Receive cost on rank 0 while every other rank streams mixed-tag messages
+// at it: probe + recv, which matches each message twice, against
+// mprobe + mrecv, which matches it once.
+// Run with: mpirun -np 4 matched_probe_benchmark
+#include <chrono>
+#include <cstdio>
+#include <random>
+
+#include "mpi_types.h"
+
+namespace {
+
+const int messagesPerSender = 50000;
+const std::vector<MessageType> tags{REQUEST_FOR_ARMOR, CONTRACT_COMPLETED, SWAP,
+                                    DELEGATE_PRIORITY, ALLOCATE_ARMOR};
+
+void receiveProbed(const mpl::communicator& communicator, MessageEnvelope& envelope) {
+  const auto& probe = communicator.probe(mpl::any_source, mpl::tag::any());
+  switch (static_cast<int>(probe.tag())) {
+    case REQUEST_FOR_ARMOR:
+      communicator.recv(envelope.get<RequestForArmor>(), probe.source(), probe.tag());
+      break;
+    case CONTRACT_COMPLETED:
+      communicator.recv(envelope.get<ContractCompleted>(), probe.source(), probe.tag());
+      break;
+    case SWAP:
+      communicator.recv(envelope.get<Swap>(), probe.source(), probe.tag());
+      break;
+    case DELEGATE_PRIORITY:
+      communicator.recv(envelope.get<DelegatePriority>(), probe.source(), probe.tag());
+      break;
+    case ALLOCATE_ARMOR:
+      communicator.recv(envelope.get<AllocateArmor>(), probe.source(), probe.tag());
+      break;
+  }
+}
+
+void receiveMatched(const mpl::communicator& communicator, MessageEnvelope& envelope) {
+  auto probe = communicator.mprobe(mpl::any_source, mpl::tag::any());
+  switch (static_cast<int>(probe.second.tag())) {
+    case REQUEST_FOR_ARMOR:
+      communicator.mrecv(envelope.get<RequestForArmor>(), probe.first);
+      break;
+    case CONTRACT_COMPLETED:
+      communicator.mrecv(envelope.get<ContractCompleted>(), probe.first);
+      break;
+    case SWAP:
+      communicator.mrecv(envelope.get<Swap>(), probe.first);
+      break;
+    case DELEGATE_PRIORITY:
+      communicator.mrecv(envelope.get<DelegatePriority>(), probe.first);
+      break;
+    case ALLOCATE_ARMOR:
+      communicator.mrecv(envelope.get<AllocateArmor>(), probe.first);
+      break;
+  }
+}
+
+void sendAll(const mpl::communicator& communicator) {
+  std::mt19937 random(communicator.rank());
+  MessageEnvelope envelope;
+  for (int i = 0; i < messagesPerSender; i++) {
+    MessageType tag = tags[random() % tags.size()];
+    switch (tag) {
+      case REQUEST_FOR_ARMOR:
+        communicator.send(envelope.get<RequestForArmor>(), 0, tag);
+        break;
+      case CONTRACT_COMPLETED:
+        communicator.send(envelope.get<ContractCompleted>(), 0, tag);
+        break;
+      case SWAP:
+        communicator.send(envelope.get<Swap>(), 0, tag);
+        break;
+      case DELEGATE_PRIORITY:
+        communicator.send(envelope.get<DelegatePriority>(), 0, tag);
+        break;
+      default:
+        communicator.send(envelope.get<AllocateArmor>(), 0, tag);
+        break;
+    }
+  }
+}
+
+template <typename Receive>
+double measure(const mpl::communicator& communicator, Receive receive) {
+  communicator.barrier();
+  if (communicator.rank() != 0) {
+    sendAll(communicator);
+    communicator.barrier();
+    return 0;
+  }
+  int total = messagesPerSender * (communicator.size() - 1);
+  MessageEnvelope envelope;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < total; i++) receive(communicator, envelope);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  communicator.barrier();
+  return std::chrono::duration<double, std::nano>(elapsed).count() / total;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const mpl::communicator& communicator(mpl::environment::comm_world());
+  if (communicator.size() < 2) {
+    printf("run with at least 2 ranks\n");
+    return 1;
+  }
+  double probedTime = measure(communicator, receiveProbed);
+  double matchedTime = measure(communicator, receiveMatched);
+  if (communicator.rank() == 0) {
+    printf("%d senders x %d messages\n", communicator.size() - 1, messagesPerSender);
+    printf("probe + recv:   %8.1f ns/message\n", probedTime);
+    printf("mprobe + mrecv: %8.1f ns/message   speedup: %.2fx\n", matchedTime,
+           probedTime / matchedTime);
+  }
+  return 0;
+}
@@ -0,0 +1,127 @@
+// Counts heap allocations made while buffering early messages, once with
+// plain new/delete and once with MessagePool, after a warm-up phase. Then
+// counts them for the whole path an early message takes through ProcessBase,
+// storeInBuffer and fetchFromBuffer with its MessageStore, under lookups by
+// source and tag like the protocol makes.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+#include "message_pool.h"
+#include "mpi_types.h"
+#include "process_base.h"
+
+namespace {
+size_t heapAllocations = 0;
+}
+
+void* operator new(size_t size) {
+  heapAllocations++;
+  if (void* memory = std::malloc(size)) return memory;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+namespace {
+
+const int buffered = 500;
+const int rounds = 200000;
+const int sources = 8;
+const MessageType bufferedTypes[] = {REQUEST_FOR_ARMOR, ALLOCATE_ARMOR, CONTRACT_COMPLETED,
+                                     DELEGATE_PRIORITY, SWAP};
+const int typeCount = sizeof(bufferedTypes) / sizeof(bufferedTypes[0]);
+
+struct HeapAllocator {
+  MessageEnvelope* create(const MessageEnvelope& message) { return new MessageEnvelope(message); }
+  void destroy(const MessageEnvelope* message) { delete message; }
+};
+
+template <typename Allocator>
+void run(const char* name, Allocator& allocator) {
+  std::mt19937 random(7);
+  std::vector<const MessageEnvelope*> slots(buffered, nullptr);
+  MessageEnvelope message{};
+
+  // warm-up fills the buffer once
+  for (auto& slot : slots) slot = allocator.create(message);
+
+  size_t allocationsBefore = heapAllocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < rounds; i++) {
+    auto& slot = slots[random() % buffered];
+    allocator.destroy(slot);
+    slot = allocator.create(message);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  size_t allocations = heapAllocations - allocationsBefore;
+
+  for (auto slot : slots) allocator.destroy(slot);
+  printf("%-10s %8zu heap allocations in steady state, %6.1f ns per buffer/unbuffer\n", name,
+         allocations, std::chrono::duration<double, std::nano>(elapsed).count() / rounds);
+}
+
+class BufferingProcess : public ProcessBase {
+ public:
+  explicit BufferingProcess(const mpl::communicator& communicator) : ProcessBase(communicator) {}
+  void run(int maxRounds) override {}
+  using ProcessBase::storeInBuffer;
+
+  // keeps buffered messages stored, each cycle takes one of a random source
+  // and type out and stores a new one; returns the heap allocations
+  size_t cycle(int cycles, std::mt19937& random, std::vector<MessageEnvelope>& live) {
+    size_t allocationsBefore = heapAllocations;
+    for (int i = 0; i < cycles; i++) {
+      auto& wanted = live[random() % live.size()];
+      auto message = fetchFromBuffer(wanted.status.source(), 1u << wanted.type);
+      releaseBuffered(message);
+      wanted = makeEnvelope(random);
+      storeInBuffer(wanted);
+    }
+    return heapAllocations - allocationsBefore;
+  }
+
+  static MessageEnvelope makeEnvelope(std::mt19937& random) {
+    MessageEnvelope envelope{};
+    envelope.type = bufferedTypes[random() % typeCount];
+    MPI_Status status{};
+    status.MPI_SOURCE = random() % sources;
+    status.MPI_TAG = envelope.type;
+    envelope.status = *reinterpret_cast<mpl::status*>(&status);
+    return envelope;
+  }
+};
+
+void runProcessBuffer() {
+  BufferingProcess process(mpl::environment::comm_self());
+  std::mt19937 random(11);
+  std::vector<MessageEnvelope> live;
+  for (int i = 0; i < buffered; i++) {
+    live.push_back(BufferingProcess::makeEnvelope(random));
+    process.storeInBuffer(live.back());
+  }
+  // the rings grow to the deepest backlog the lookups leave behind
+  process.cycle(rounds, random, live);
+  auto start = std::chrono::steady_clock::now();
+  size_t allocations = process.cycle(rounds, random, live);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  printf("%-10s %8zu heap allocations in steady state, %6.1f ns per buffer/unbuffer\n",
+         "buffer", allocations, std::chrono::duration<double, std::nano>(elapsed).count() / rounds);
+}
+
+}  // namespace
+
+int main() {
+  printf("%d buffered messages, %d buffer/unbuffer cycles\n", buffered, rounds);
+  HeapAllocator heap;
+  run("new/delete", heap);
+  MessagePool<MessageEnvelope> pool;
+  run("pool", pool);
+  printf("pool went to the heap %zu times during warm-up\n", pool.getChunkAllocations());
+  runProcessBuffer();
+  return 0;
+}
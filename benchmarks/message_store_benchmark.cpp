@@ -0,0 +1,106 @@
+// Compares the bucketed MessageStore with the list + find_if buffer it
+// replaced, with 10k out-of-order messages kept buffered.
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <random>
+
+#include "message_store.h"
+#include "mpi_types.h"
+
+namespace {
+
+const int bufferedMessages = 10000;
+const int lookups = 20000;
+const int sources = 64;
+const std::vector<MessageType> tags{REQUEST_FOR_ARMOR, CONTRACT_COMPLETED, SWAP,
+                                    DELEGATE_PRIORITY, ALLOCATE_ARMOR};
+
+mpl::status makeStatus(int source, mpl::tag tag) {
+  MPI_Status raw{};
+  raw.MPI_SOURCE = source;
+  raw.MPI_TAG = static_cast<int>(tag);
+  return *reinterpret_cast<mpl::status*>(&raw);
+}
+
+// The buffer as it was before MessageStore
+class ListBuffer {
+  std::list<std::pair<const MessageEnvelope*, mpl::status>> messageBuffer;
+
+ public:
+  void push(const MessageEnvelope* envelope) {
+    messageBuffer.emplace_back(envelope, envelope->status);
+  }
+
+  const MessageEnvelope* pop(int sourceRank, unsigned tagMask) {
+    std::vector<mpl::tag> tags;
+    for (int tag = 0; tag < MESSAGE_TYPE_COUNT; tag++) {
+      if (tagMask & (1u << tag)) tags.emplace_back(tag);
+    }
+    std::function<bool(std::pair<const MessageEnvelope*, mpl::status>)> predicate;
+    if (sourceRank == mpl::any_source) {
+      predicate = [tags](std::pair<const MessageEnvelope*, mpl::status> message) {
+        return std::find(tags.begin(), tags.end(), message.second.tag()) != tags.end();
+      };
+    } else {
+      predicate = [sourceRank, tags](std::pair<const MessageEnvelope*, mpl::status> message) {
+        return (message.second.source() == sourceRank) &&
+               (std::find(tags.begin(), tags.end(), message.second.tag()) != tags.end());
+      };
+    }
+    auto iterator = std::find_if(messageBuffer.begin(), messageBuffer.end(), predicate);
+    if (iterator == messageBuffer.end()) return nullptr;
+    auto envelope = iterator->first;
+    messageBuffer.erase(iterator);
+    return envelope;
+  }
+};
+
+template <typename Buffer>
+double run(Buffer& buffer, bool wildcard) {
+  std::mt19937 random(42);
+  std::vector<MessageEnvelope> envelopes(bufferedMessages);
+  for (auto& envelope : envelopes) {
+    envelope.type = tags[random() % tags.size()];
+    envelope.status = makeStatus(random() % sources, envelope.type);
+    buffer.push(&envelope);
+  }
+
+  std::vector<std::pair<int, unsigned>> queries(lookups);
+  for (auto& query : queries) {
+    query.first = wildcard ? mpl::any_source : random() % sources;
+    query.second = 1u << tags[random() % tags.size()];
+  }
+
+  int misses = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (const auto& query : queries) {
+    const MessageEnvelope* envelope = buffer.pop(query.first, query.second);
+    if (envelope == nullptr) {
+      misses++;
+      continue;
+    }
+    // keep the buffer at a steady size
+    buffer.push(envelope);
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  if (misses > 0) printf("  (%d lookups found nothing)\n", misses);
+  return std::chrono::duration<double, std::nano>(elapsed).count() / lookups;
+}
+
+}  // namespace
+
+int main() {
+  printf("%d buffered messages, %d sources, %d lookups\n", bufferedMessages, sources, lookups);
+  for (bool wildcard : {false, true}) {
+    ListBuffer list;
+    MessageStore store;
+    double listTime = run(list, wildcard);
+    double storeTime = run(store, wildcard);
+    printf("%-10s list: %10.1f ns/lookup   store: %8.1f ns/lookup   speedup: %.1fx\n",
+           wildcard ? "any_source" : "exact", listTime, storeTime, listTime / storeTime);
+  }
+  return 0;
+}
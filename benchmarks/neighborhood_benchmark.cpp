@@ -0,0 +1,97 @@
+// Exchanging one int among the first K ranks of the world: building the
+// distributed graph communicator, a neighbor_allgather over it, and the
+// point-to-point isend/recv all-to-all it replaces. The graph pays off once
+// it is reused for more rounds than the printed break-even.
+// Run with: mpirun -np 8 neighborhood_benchmark [ROUNDS]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mpl/mpl.hpp>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double microseconds(Clock::duration elapsed) {
+  return std::chrono::duration<double, std::micro>(elapsed).count();
+}
+
+mpl::dist_graph_communicator buildNeighborhood(const mpl::communicator& world, int members) {
+  mpl::dist_graph_communicator::source_set sources;
+  mpl::dist_graph_communicator::dest_set destinations;
+  if (world.rank() < members) {
+    for (int member = 0; member < members; member++) {
+      if (member == world.rank()) continue;
+      sources.insert({member, 1});
+      destinations.insert({member, 1});
+    }
+  }
+  return mpl::dist_graph_communicator(world, sources, destinations, false);
+}
+
+double measureCreation(const mpl::communicator& world, int members, int rounds) {
+  world.barrier();
+  auto start = Clock::now();
+  for (int round = 0; round < rounds; round++) {
+    auto neighborhood = buildNeighborhood(world, members);
+  }
+  return microseconds(Clock::now() - start) / rounds;
+}
+
+double measureCollective(const mpl::communicator& world, int members, int rounds) {
+  auto neighborhood = buildNeighborhood(world, members);
+  std::vector<int> received(neighborhood.indegree());
+  world.barrier();
+  auto start = Clock::now();
+  for (int round = 0; round < rounds; round++) {
+    neighborhood.neighbor_allgather(round, received.data());
+  }
+  return microseconds(Clock::now() - start) / rounds;
+}
+
+double measurePointToPoint(const mpl::communicator& world, int members, int rounds) {
+  int received;
+  mpl::irequest_pool requests;
+  world.barrier();
+  auto start = Clock::now();
+  for (int round = 0; round < rounds && world.rank() < members; round++) {
+    for (int member = 0; member < members; member++) {
+      if (member != world.rank()) requests.push(world.isend(round, member));
+    }
+    for (int member = 1; member < members; member++) world.recv(received, mpl::any_source);
+    requests.waitall();
+    requests = mpl::irequest_pool();
+  }
+  // unemployed ranks still wait for the round like they do in the collective
+  world.barrier();
+  return microseconds(Clock::now() - start) / rounds;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  const int rounds = argc > 1 ? atoi(argv[1]) : 1000;
+  const mpl::communicator& world(mpl::environment::comm_world());
+  if (world.rank() == 0) {
+    printf("%d ranks, %d rounds\n", world.size(), rounds);
+    printf("%8s %12s %14s %14s %11s\n", "members", "create us", "collective us", "p2p us",
+           "break-even");
+  }
+  for (int members = 2; members <= world.size(); members *= 2) {
+    double creation = measureCreation(world, members, rounds / 10 + 1);
+    double collective = measureCollective(world, members, rounds);
+    double pointToPoint = measurePointToPoint(world, members, rounds);
+    if (world.rank() == 0) {
+      double saved = pointToPoint - collective;
+      if (saved > 0) {
+        printf("%8d %12.2f %14.2f %14.2f %11.0f\n", members, creation, collective, pointToPoint,
+               creation / saved);
+      } else {
+        printf("%8d %12.2f %14.2f %14.2f %11s\n", members, creation, collective, pointToPoint,
+               "never");
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,64 @@
+#ifndef BENCHMARKS_PROTOCOL_BENCHMARK_H_
+#define BENCHMARKS_PROTOCOL_BENCHMARK_H_
+
+// Shared by the benchmarks that run the full landlord/gnome protocol. They
+// accept the same options as the main program.
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+#include "arg_parser.h"
+#include "gnome.h"
+#include "landlord.h"
+
+// contracts without hamsters so rampage sleeps do not hide protocol time,
+// and more poison than anybody needs
+inline Configuration getDefaults(int rounds, int swords) {
+  Configuration defaults;
+  defaults.maxRounds = rounds;
+  defaults.minHamstersPerContract = 0;
+  defaults.maxHamstersPerContract = 0;
+  defaults.swordsTotal = swords;
+  defaults.poisonTotal = 100;
+  return defaults;
+}
+
+// parses the options and sets the contract and armory sizes from them
+inline Configuration parseOptions(int argc, char** argv, const Configuration& defaults) {
+  auto config = ArgParser::parse(argc, argv, defaults);
+  Landlord::minHamstersPerContract = config.minHamstersPerContract;
+  Landlord::maxHamstersPerContract = config.maxHamstersPerContract;
+  Gnome::swordsTotal = config.swordsTotal;
+  Gnome::poisonTotal = config.poisonTotal;
+  return config;
+}
+
+// the protocol logs every step to stdout, results go to stderr
+inline void discardProtocolLog() {
+  freopen("/dev/null", "w", stdout);
+}
+
+// Runs the protocol for rounds on a duplicate of world, which keeps stray
+// messages of one run out of the next, and returns its wall time in
+// seconds. afterRun sees every gnome before it is torn down.
+inline double runProtocol(const mpl::communicator& world, int rounds,
+                          const std::function<void(const Gnome&)>& afterRun = nullptr) {
+  mpl::communicator communicator(world);
+  const bool isLandlord = communicator.rank() == Landlord::landlordRank;
+  mpl::communicator gnomeCommunicator(mpl::communicator::split(), communicator,
+                                      isLandlord ? mpl::undefined : 1, communicator.rank());
+  communicator.barrier();
+  auto start = std::chrono::steady_clock::now();
+  if (isLandlord) {
+    Landlord landlord(communicator);
+    landlord.run(rounds);
+  } else {
+    Gnome gnome(communicator, gnomeCommunicator);
+    gnome.run(rounds);
+    if (afterRun) afterRun(gnome);
+  }
+  communicator.barrier();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+#endif  // BENCHMARKS_PROTOCOL_BENCHMARK_H_
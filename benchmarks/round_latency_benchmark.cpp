@@ -0,0 +1,29 @@
+// Wall time per contract round of the full landlord/gnome protocol, run
+// once with the state machine doing its own MPI calls and once with the
+// progress thread.
+// Run with: mpirun -np 8 round_latency_benchmark [-r ROUNDS]
+#include <cstdio>
+
+#include "protocol_benchmark.h"
+
+int main(int argc, char** argv) {
+  auto config = parseOptions(argc, argv, getDefaults(200, 3));
+  ProcessBase::maxFrameBytes = config.frameBytes;
+  ProcessBase::usePackedCodec = config.packedCodec;
+  ContractBroadcast::enabled = config.contractBroadcast;
+
+  const mpl::communicator& world(mpl::environment::comm_world());
+  discardProtocolLog();
+
+  ProcessBase::useProgressThread = false;
+  double inlineTime = 1000 * runProtocol(world, config.maxRounds) / config.maxRounds;
+  ProcessBase::useProgressThread = true;
+  double threadTime = 1000 * runProtocol(world, config.maxRounds) / config.maxRounds;
+
+  if (world.rank() == Landlord::landlordRank) {
+    fprintf(stderr, "%d ranks, %d rounds\n", world.size(), config.maxRounds);
+    fprintf(stderr, "state machine receives: %8.3f ms/round\n", inlineTime);
+    fprintf(stderr, "progress thread:        %8.3f ms/round\n", threadTime);
+  }
+  return 0;
+}
@@ -0,0 +1,28 @@
+// Cost of recording one trace event on the calling thread, window remaps
+// included. Tracing is meant to stay on, so this has to stay well under
+// 100 ns. Writes to TRACE_PREFIX0.trace, /tmp/trace_benchmark_ by default.
+// Run with: trace_benchmark [EVENTS] [TRACE_PREFIX]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include "trace.h"
+
+int main(int argc, char** argv) {
+  const int events = argc > 1 ? atoi(argv[1]) : 10000000;
+  TraceWriter::filePrefix = argc > 2 ? argv[2] : "/tmp/trace_benchmark_";
+  double nanoseconds;
+  {
+    TraceWriter trace(0, "BENCHMARK");
+    if (!trace.isEnabled()) return EXIT_FAILURE;
+    auto start = std::chrono::steady_clock::now();
+    for (int event = 0; event < events; event++) {
+      trace.record(TraceEvent::SEND, event % 8, event % 16, event, event / 1000);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / events;
+  }
+  printf("%d events, %.1f ns/event, %.1f MB\n", events, nanoseconds,
+         events * sizeof(TraceRecord) / 1e6);
+  return 0;
+}
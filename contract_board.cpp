@@ -0,0 +1,55 @@
+#include "contract_board.h"
+
+#include <unistd.h>
+
+namespace {
+
+const int pollMicroseconds = 10;
+
+}  // namespace
+
+bool ContractBoard::enabled = false;
+
+ContractBoard::ContractBoard(const mpl::communicator& communicator, int hostRank, int capacity)
+    : hostRank(hostRank),
+      readers(communicator.size() - 1),
+      board(communicator.rank() == hostRank
+                ? CONTRACTS + capacity * sizeof(Contract) / sizeof(int)
+                : 0),
+      window(communicator, board.data(), board.size()),
+      nextWave(1) {
+  window.lock_all(MPI_MODE_NOCHECK);
+}
+
+ContractBoard::~ContractBoard() {
+  window.unlock_all();
+}
+
+int ContractBoard::read(Field field) {
+  return window.fetch_and_op(0, mpl::no_op<int>(), hostRank, field);
+}
+
+void ContractBoard::publish(const std::vector<Contract>& contracts) {
+  // the previous wave stays up until every reader has it
+  if (nextWave > 1) {
+    while (read(READERS) < readers) usleep(pollMicroseconds);
+  }
+  int count = contracts.size();
+  window.put(contracts.data(), mpl::vector_layout<Contract>(count), hostRank, CONTRACTS);
+  // accumulate completes at the host, with the put before it, so readers
+  // never see the new wave ahead of its contracts
+  window.accumulate(count, mpl::replace<int>(), hostRank, COUNT);
+  window.accumulate(0, mpl::replace<int>(), hostRank, READERS);
+  window.accumulate(nextWave, mpl::replace<int>(), hostRank, WAVE);
+  nextWave++;
+}
+
+void ContractBoard::fetch(std::vector<Contract>& contracts) {
+  while (read(WAVE) < nextWave) usleep(pollMicroseconds);
+  nextWave++;
+  contracts.resize(read(COUNT));
+  window.get(contracts.data(), mpl::vector_layout<Contract>(contracts.size()), hostRank,
+             CONTRACTS);
+  window.flush(hostRank);
+  window.accumulate(1, mpl::plus<int>(), hostRank, READERS);
+}
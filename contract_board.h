@@ -0,0 +1,36 @@
+#ifndef CONTRACT_BOARD_H_
+#define CONTRACT_BOARD_H_
+
+#include <mpl/mpl.hpp>
+#include <vector>
+
+#include "mpi_types.h"
+
+// Contract waves published in an MPI window on the host rank. The host
+// writes a wave and bumps the wave counter, readers pull it with MPI_Get
+// and check in, and the host only overwrites a wave everybody has read.
+// Construction and destruction are collective.
+class ContractBoard {
+ private:
+  enum Field { WAVE, COUNT, READERS, CONTRACTS };  // int offsets in the board
+
+  const int hostRank;
+  const int readers;
+  std::vector<int> board;  // exposed only by the host
+  mpl::window window;
+  int nextWave;
+
+  int read(Field field);
+
+ public:
+  static bool enabled;
+
+  ContractBoard(const mpl::communicator& communicator, int hostRank, int capacity);
+  ~ContractBoard();
+
+  void publish(const std::vector<Contract>& contracts);
+  // waits for the wave after the last one fetched
+  void fetch(std::vector<Contract>& contracts);
+};
+
+#endif  // CONTRACT_BOARD_H_
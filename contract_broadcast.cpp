@@ -0,0 +1,53 @@
+#include "contract_broadcast.h"
+
+bool ContractBroadcast::enabled = false;
+
+ContractBroadcast::ContractBroadcast(const mpl::communicator& communicator, int rootRank,
+                                     int capacity)
+    : rootRank(rootRank),
+      communicator(communicator),
+      slotLayout(capacity + 1),
+      postSlot(0),
+      fetchSlot(0) {
+  for (auto& slot : slots) slot.resize(capacity + 1);
+}
+
+ContractBroadcast::~ContractBroadcast() {
+  for (auto& request : requests) {
+    if (request) request->wait();
+  }
+}
+
+void ContractBroadcast::post() {
+  requests[postSlot].reset(
+      new mpl::irequest(communicator.ibcast(rootRank, slots[postSlot].data(), slotLayout)));
+  postSlot = (postSlot + 1) % slotCount;
+}
+
+void ContractBroadcast::publish(const std::vector<Contract>& contracts) {
+  // the slot is free again once its previous wave has reached everybody
+  if (requests[postSlot]) requests[postSlot]->wait();
+  auto& slot = slots[postSlot];
+  slot[0].contractId = contracts.size();
+  std::copy(contracts.begin(), contracts.end(), slot.begin() + 1);
+  post();
+}
+
+void ContractBroadcast::prefetch() {
+  post();
+}
+
+void ContractBroadcast::fetch(std::vector<Contract>& contracts) {
+  if (!requests[fetchSlot]) prefetch();
+  requests[fetchSlot]->wait();
+  requests[fetchSlot].reset();
+  const auto& slot = slots[fetchSlot];
+  contracts.assign(slot.begin() + 1, slot.begin() + 1 + slot[0].contractId);
+  fetchSlot = (fetchSlot + 1) % slotCount;
+}
+
+void ContractBroadcast::progress() {
+  for (auto& request : requests) {
+    if (request) request->test();
+  }
+}
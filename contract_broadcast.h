@@ -0,0 +1,47 @@
+#ifndef CONTRACT_BROADCAST_H_
+#define CONTRACT_BROADCAST_H_
+
+#include <memory>
+#include <mpl/mpl.hpp>
+#include <vector>
+
+#include "mpi_types.h"
+
+// Contract waves sent with a nonblocking broadcast on a private duplicate of
+// the communicator, so the root keeps working while a wave goes out. A wave
+// travels in a fixed-size slot whose first element carries the number of
+// contracts, and waves alternate between two slots so the next one can be
+// posted before the previous has completed everywhere. Construction is
+// collective, and every receiver must fetch every wave the root publishes.
+class ContractBroadcast {
+ private:
+  static const int slotCount = 2;
+
+  const int rootRank;
+  mpl::communicator communicator;
+  mpl::vector_layout<Contract> slotLayout;
+  std::vector<Contract> slots[slotCount];
+  std::unique_ptr<mpl::irequest> requests[slotCount];
+  int postSlot;   // slot of the next wave posted
+  int fetchSlot;  // slot of the next wave fetched
+
+  void post();
+
+ public:
+  static bool enabled;
+
+  ContractBroadcast(const mpl::communicator& communicator, int rootRank, int capacity);
+  // waits for waves still in flight
+  ~ContractBroadcast();
+
+  // starts sending a wave and returns without waiting for it
+  void publish(const std::vector<Contract>& contracts);
+  // starts receiving the wave after the last one prefetched or fetched
+  void prefetch();
+  // waits for the wave after the last one fetched
+  void fetch(std::vector<Contract>& contracts);
+  // lets waves in flight advance, cheap enough for every event loop step
+  void progress();
+};
+
+#endif  // CONTRACT_BROADCAST_H_
@@ -4,26 +4,92 @@
 
 #include "landlord.h"
 #include "mpi_types.h"
+#include "permission_armory.h"
+#include "rma_armory.h"
 
 int Gnome::swordsTotal = 5;
 int Gnome::poisonTotal = 30;
-
-Gnome::Gnome(const mpl::communicator &communicator)
+const int Gnome::armoryRetryMicroseconds = 50;
+const int Gnome::rampageSliceMicroseconds = 1000;
+bool Gnome::useNeighborCollectives = false;
+
+const ProcessBase::HandlerTable<Gnome> Gnome::takingInventoryHandlers{{
+    nullptr,                          // CONTRACTS
+    nullptr,                          // REQUEST_FOR_CONTRACT
+    &Gnome::handleRequestForArmor,    // REQUEST_FOR_ARMOR
+    &Gnome::handleAllocateArmor,      // ALLOCATE_ARMOR
+    &Gnome::handleContractCompleted,  // CONTRACT_COMPLETED
+    &Gnome::handleDelegatePriority,   // DELEGATE_PRIORITY
+    &Gnome::handleSwap,               // SWAP
+    nullptr,                          // CREDIT
+}};
+
+const ProcessBase::HandlerTable<Gnome> Gnome::delegatingPriorityHandlers{{
+    nullptr,                                   // CONTRACTS
+    nullptr,                                   // REQUEST_FOR_CONTRACT
+    nullptr,                                   // REQUEST_FOR_ARMOR
+    &Gnome::handleAllocateArmorDelegating,     // ALLOCATE_ARMOR
+    nullptr,                                   // CONTRACT_COMPLETED
+    &Gnome::handleDelegatePriorityDelegating,  // DELEGATE_PRIORITY
+    &Gnome::handleSwapDelegating,              // SWAP
+    nullptr,                                   // CREDIT
+}};
+
+// Armor is taken, so what peers send about this round no longer matters, but
+// taking it out of MPI keeps their credits and the unexpected queue moving.
+// Delegating to a rampaging gnome is answered by its ALLOCATE_ARMOR.
+const ProcessBase::HandlerTable<Gnome> Gnome::rampageHandlers{{
+    nullptr,          // CONTRACTS
+    nullptr,          // REQUEST_FOR_CONTRACT
+    &Gnome::discard,  // REQUEST_FOR_ARMOR
+    &Gnome::discard,  // ALLOCATE_ARMOR
+    &Gnome::discard,  // CONTRACT_COMPLETED
+    &Gnome::discard,  // DELEGATE_PRIORITY
+    &Gnome::discard,  // SWAP
+    nullptr,          // CREDIT
+}};
+
+Gnome::Gnome(const mpl::communicator &communicator,
+             const mpl::communicator &gnomeCommunicator)
     : ProcessBase(communicator, "GNOME"),
       numberOfGnomes(communicator.size() - 1),
+      gnomeCommunicator(gnomeCommunicator),
       minValidContractId(0),
-      bloodHunger(0) {}
+      bloodHunger(0) {
+  mpl::group gnomeGroup(gnomeCommunicator);
+  mpl::group worldGroup(communicator);
+  gnomeRanks.resize(gnomeCommunicator.size());
+  for (int i = 0; i < gnomeRanks.size(); i++) {
+    gnomeRanks[i] = gnomeGroup.translate(i, worldGroup);
+  }
+  // the landlord never offers more contracts than there are gnomes
+  contracts.reserve(numberOfGnomes);
+  if (RmaArmory::enabled) {
+    armory.reset(new RmaArmory(communicator, Landlord::landlordRank, swordsTotal, poisonTotal));
+  } else if (PermissionArmory::enabled) {
+    armory.reset(new PermissionArmory(gnomeCommunicator, swordsTotal, poisonTotal));
+  }
+  if (ContractBoard::enabled) {
+    contractBoard.reset(new ContractBoard(communicator, Landlord::landlordRank, numberOfGnomes));
+  } else if (ContractBroadcast::enabled) {
+    contractBroadcast.reset(
+        new ContractBroadcast(communicator, Landlord::landlordRank, numberOfGnomes));
+  }
+}
 
 void Gnome::run(int maxRounds) {
-  log("I'm alive!");
+  LOG(INFO, "I'm alive!");
 
   state = PEACE_IS_A_LIE;
   int round = 0;
 
   while (round != maxRounds) {
+    traceState(state);
     switch (state) {
       case PEACE_IS_A_LIE: {
         doPeaceIsALie();
+        // the next wave arrives in the background while this one is worked on
+        if (contractBroadcast && round + 1 != maxRounds) contractBroadcast->prefetch();
         break;
       }
       case GATHER_PARTY: {
@@ -49,83 +115,122 @@ void Gnome::run(int maxRounds) {
       }
       default: {
         // Should never reach here
-        log("Entered superposition state. Committing suicide.");
+        LOG(WARNING, "Entered superposition state. Committing suicide.");
         return;
       }
     }
+    // messages coalesced during a step never wait longer than the step
+    flushFrames();
+    if (contractBroadcast) contractBroadcast->progress();
+  }
+  // the windows freed after the last round are collective, so nothing may
+  // stay held back until the destructor
+  flushDeferred();
+  logStatistics();
+  LOG(INFO, "Average armory allocation latency: %.3f ms over %d contracts",
+      getAverageAllocationLatency(), allocations);
+  if (allocations > 0) {
+    LOG(INFO, "Armory messages sent: %.1f per contract",
+        static_cast<double>(getArmoryMessages()) / allocations);
   }
-  log("No work left for brave warrior. Committing suicide.");
+  LOG(INFO, "No work left for brave warrior. Committing suicide.");
+}
+
+double Gnome::getAverageAllocationLatency() const {
+  return allocations == 0 ? 0 : allocationMilliseconds / allocations;
 }
 
 void Gnome::doPeaceIsALie() {
-  log("Looking forward for new contracts");
+  LOG(INFO, "Looking forward for new contracts");
   minValidContractId += contracts.size();
-  receiveVector(contracts, Landlord::landlordRank, CONTRACTS);
-  log("Received contract list.");
+  // also sends what flow control held back, waiting for a wave nobody's
+  // credits could release it
+  advanceEpoch();
+  if (contractBoard) {
+    contractBoard->fetch(contracts);
+    stampIncoming(contracts);
+  } else if (contractBroadcast) {
+    contractBroadcast->fetch(contracts);
+    stampIncoming(contracts);
+  } else {
+    receiveVector(contracts, Landlord::landlordRank, CONTRACTS);
+  }
+  LOG(INFO, "Received contract list with %zu contracts.", contracts.size());
 
-  log("Broadcasting REQUEST_FOR_CONTRACT to other gnomes");
+  LOG(DEBUG, "Exchanging REQUEST_FOR_CONTRACT with other gnomes");
   RequestForContract request(bloodHunger);
-  setBroadcastScope(getAllGnomeRanks());
-  broadcast(request, REQUEST_FOR_CONTRACT);
+  allgather(gnomeCommunicator, request, contractRequests);
 
+  // Every gnome builds the same queue from the gathered requests
   contractQueue.clear();
-  contractQueue.push_back(ContractQueueItem{rank, request});
+  for (int i = 0; i < contractRequests.size(); i++) {
+    contractQueue.push_back(ContractQueueItem{gnomeRanks[i], contractRequests[i]});
+  }
 
   state = GATHER_PARTY;
 }
 
 void Gnome::doGatherParty() {
-  // Get REQUEST_FOR_CONTRACT from other gnomes
-  while (contractQueue.size() < numberOfGnomes) {
-    RequestForContract request{};
-    const auto &status = receiveAny(request, REQUEST_FOR_CONTRACT);
-    contractQueue.push_back(ContractQueueItem{status.source(), request});
-    log("Received REQUEST_FOR_CONTRACT [ timestamp: %d ] from GNOME %d",
-        request.timestamp, status.source());
+  bool employed = getContract();
+  if (employed) inventoryStart = std::chrono::steady_clock::now();
+  if (useNeighborCollectives && !armory) {
+    exchangeArmorRequests(employed);
   }
 
-  flush<AllocateArmor>(ALLOCATE_ARMOR);
-  flush<DelegatePriority>(DELEGATE_PRIORITY);
-  flush<Swap>(SWAP);
-
   // If we didn't get a contract, increase blood hunger and finish round
-  if (!getContract()) {
-    log("No work for me. Gonna rest a bit.");
+  if (!employed) {
+    LOG(INFO, "No work for me. Gonna rest a bit.");
     bloodHunger++;
     state = FINISH;
     return;
   }
 
+  LOG(INFO, "Determined my contract id: %d", currentContractId);
+  if (armory) {
+    swordsNeeded = 1;
+    poisonNeeded = getContractById(currentContractId).numberOfHamsters;
+    state = TAKING_INVENTORY;
+    return;
+  }
+
   // If we got a contract, send REQUEST_FOR_ARMOR to all gnomes with contracts
-  log("Determined my contract id: %d", currentContractId);
-  log("Broadcasting REQUEST_FOR_ARMOR to other gnomes");
-  RequestForArmor request(currentContractId);
   setBroadcastScope(getEmployedGnomeRanks());
-  broadcast(request, REQUEST_FOR_ARMOR);
-
-  armoryQueue.clear();
-  armoryQueue.reserve(contracts.size());
-  armoryQueue.emplace_back(rank, request);
-  positionInArmoryQueue = armoryQueue.begin();
-
-  swordsNeeded = contracts.size();
-  poisonNeeded = 0;
-  for (auto contract : contracts) {
-    poisonNeeded += contract.numberOfHamsters;
+  if (!useNeighborCollectives) {
+    LOG(DEBUG, "Broadcasting REQUEST_FOR_ARMOR to other gnomes");
+    RequestForArmor request(currentContractId);
+    broadcast(request, REQUEST_FOR_ARMOR);
+    countArmoryFanOut();
+    startArmoryQueue(request);
   }
 
-  log("Gonna take some stuff from armoury, swords_needed = %d, poison_kits_needed = %d",
+  LOG(INFO, "Gonna take some stuff from armoury, swords_needed = %d, poison_kits_needed = %d",
         swordsNeeded, poisonNeeded);
   state = TAKING_INVENTORY;
 }
 
 void Gnome::doTakingInventory() {
+  if (armory) {
+    if (armory->tryAcquire(swordsNeeded, poisonNeeded)) {
+      LOG(INFO, "Took a sword and %d poison kits from the armory.", poisonNeeded);
+      startRampage();
+    } else {
+      usleep(armoryRetryMicroseconds);
+    }
+    return;
+  }
+
   if (swordsNeeded <= swordsTotal && poisonNeeded <= poisonTotal) {
-    log("There is enough stuff available.");
-    log("Broadcasting ALLOCATE_ARMOR to other gnomes");
+    LOG(DEBUG, "There is enough stuff available.");
+    LOG(DEBUG, "Broadcasting ALLOCATE_ARMOR to other gnomes");
     AllocateArmor message{};
     broadcast(message, ALLOCATE_ARMOR);
-    state = RAMPAGE;
+    countArmoryFanOut();
+    startRampage();
+    return;
+  }
+
+  if (postponedDelegatingRank != -1) {
+    acceptDelegation(postponedDelegatingRank);
     return;
   }
 
@@ -134,82 +239,103 @@ void Gnome::doTakingInventory() {
     if (swapRank != rank) {
       DelegatePriority message;
       send(message, swapRank, DELEGATE_PRIORITY);
+      armoryMessages++;
       state = DELEGATING_PRIORITY;
       return;
     }
   }
 
-  std::unordered_map<
-      int, std::function<void(const MessageBase *, const mpl::status &)>>
-      messageHandlers{
-          {REQUEST_FOR_ARMOR,
-           [this](const MessageBase *message, const mpl::status &status) {
-             handleRequestForArmor(message, status);
-           }},
-          {CONTRACT_COMPLETED,
-           [this](const MessageBase *message, const mpl::status &status) {
-             handleContractCompleted(message, status);
-           }},
-          {SWAP,
-           [this](const MessageBase *message, const mpl::status &status) {
-             handleSwap(message, status);
-           }},
-          {DELEGATE_PRIORITY,
-           [this](const MessageBase *message, const mpl::status &status) {
-             handleDelegatePriority(status);
-           }},
-          {ALLOCATE_ARMOR,
-           [](const MessageBase *message, const mpl::status &status) {
-             // Receive and skip
-           }}};
-
-  receiveMultiTag(mpl::any_source, messageHandlers);
+  receiveMultiTag(mpl::any_source, takingInventoryHandlers);
 }
 
 void Gnome::doDelegatingPriority() {
-  std::unordered_map<
-      int, std::function<void(const MessageBase *, const mpl::status &)>>
-      messageHandlers{
-          {SWAP,
-           [this](const MessageBase *message, const mpl::status &status) {
-             handleSwapDelegating(message, status);
-           }},
-          {ALLOCATE_ARMOR,
-           [this](const MessageBase *message, const mpl::status &status) {
-             handleAllocateArmorDelegating(message, status);
-           }},
-          {DELEGATE_PRIORITY,
-           [](const MessageBase *message, const mpl::status &status) {
-             // Receive and skip
-           }}};
-
-  receiveMultiTag(mpl::any_source, messageHandlers);
+  receiveMultiTag(mpl::any_source, delegatingPriorityHandlers);
+}
+
+void Gnome::startRampage() {
+  auto now = std::chrono::steady_clock::now();
+  allocationMilliseconds += std::chrono::duration<double, std::milli>(now - inventoryStart).count();
+  allocations++;
+  LOG(INFO, "I'm ready TO KILL!!!");
+  // Time proportional to number of hamsters to kill, *fairness noises*
+  int rampageMilliseconds = getContractById(currentContractId).numberOfHamsters * 100;
+  if (useVirtualTime) {
+    spendVirtualTime(rampageMilliseconds);
+    rampageDeadline = now;
+  } else {
+    rampageDeadline = now + std::chrono::milliseconds(rampageMilliseconds);
+  }
+  state = RAMPAGE;
 }
 
 void Gnome::doRampage() {
-  log("I'm ready TO KILL!!!");
-  // Sleep time proportional to number of hamsters to kill, *fairness noises*
-  usleep(getContractById(currentContractId).numberOfHamsters * 1e5);
-  log("Wildly murdered %d hamsters and completed my contract (CONTRACT_ID: %d).",
+  auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+      rampageDeadline - std::chrono::steady_clock::now());
+  if (remaining.count() > 0) {
+    if (!receiveMultiTag(mpl::any_source, rampageHandlers, false)) {
+      usleep(std::min<long>(remaining.count(), rampageSliceMicroseconds));
+    }
+    return;
+  }
+  LOG(INFO, "Wildly murdered %d hamsters and completed my contract (CONTRACT_ID: %d).",
       getContractById(currentContractId).numberOfHamsters, currentContractId);
-  log("Broadcasting CONTRACT_COMPLETE");
   ContractCompleted message(currentContractId);
+  if (armory) {
+    armory->release(swordsNeeded, poisonNeeded);
+    send(message, Landlord::landlordRank, CONTRACT_COMPLETED);
+    bloodHunger = 0;
+    state = FINISH;
+    return;
+  }
+  LOG(DEBUG, "Broadcasting CONTRACT_COMPLETE");
+  // one fan-out reaches the landlord and the other employed gnomes
+  auto recipientRanks = getEmployedGnomeRanks();
+  recipientRanks.push_back(Landlord::landlordRank);
+  setBroadcastScope(recipientRanks);
   broadcast(message, CONTRACT_COMPLETED);
-  send(message, Landlord::landlordRank, CONTRACT_COMPLETED);
+  countArmoryFanOut();
 
   bloodHunger = 0;
   state = FINISH;
 }
 
-const Contract& Gnome::getContractById(int id) const {
-  return contracts[id - minValidContractId];
+void Gnome::startArmoryQueue(const RequestForArmor &request) {
+  armoryQueue.clear();
+  armoryQueue.reserve(contracts.size());
+  swapQueue.clear();
+  armedRanks.clear();
+  completedContracts.assign(contracts.size(), false);
+  postponedDelegatingRank = -1;
+  armoryQueue.emplace_back(rank, request);
+  countArmorNeeded();
 }
 
-std::vector<int> Gnome::getAllGnomeRanks() const {
-  auto ranks = std::vector<int>(numberOfGnomes + 1);
-  std::iota(ranks.begin(), ranks.end(), 0);
-  ranks.erase(std::find(ranks.begin(), ranks.end(), Landlord::landlordRank));
-  return ranks;
+void Gnome::exchangeArmorRequests(bool employed) {
+  // every gnome takes part, the unemployed ones with no neighbors
+  std::vector<int> members(contracts.size());
+  for (int i = 0; i < contracts.size(); i++) {
+    members[i] = std::distance(
+        gnomeRanks.begin(), std::find(gnomeRanks.begin(), gnomeRanks.end(), contractQueue[i].rank));
+  }
+  std::sort(members.begin(), members.end());
+  const auto &neighborhood = getNeighborhood(gnomeCommunicator, members);
+
+  RequestForArmor request(employed ? currentContractId : 0);
+  neighborAllgather(neighborhood, request, armorRequests);
+  if (!employed) return;
+  armoryMessages += armorRequests.size();
+
+  LOG(DEBUG, "Exchanged REQUEST_FOR_ARMOR with %zu other gnomes", armorRequests.size());
+  startArmoryQueue(request);
+  auto neighbor = members.begin();
+  for (const auto &neighborRequest : armorRequests) {
+    if (*neighbor == gnomeCommunicator.rank()) ++neighbor;
+    enqueueArmorRequest(gnomeRanks[*neighbor++], neighborRequest);
+  }
+}
+
+const Contract& Gnome::getContractById(int id) const {
+  return contracts[id - minValidContractId];
 }
 
 std::vector<int> Gnome::getEmployedGnomeRanks() const {
@@ -227,10 +353,13 @@ bool Gnome::getContract() {
       contractQueue.begin(), contractQueue.end(),
       [=](const ContractQueueItem &item) { return item.rank == rank; });
 
-  log("Contract queue:");
-  for (const auto &contract : contractQueue) {
-    log("[ RANK: %d; LAMPORT_CLOCK: %d; BLOOD_HUNGER: %d ]",
-        contract.rank, contract.request.timestamp, contract.request.bloodHunger);
+  // a line per gnome on every gnome, only worth it when traced
+  if (isLogged<LogLevel::TRACE>()) {
+    LOG(TRACE, "Contract queue:");
+    for (const auto &contract : contractQueue) {
+      LOG(TRACE, "[ RANK: %d; LAMPORT_CLOCK: %d; BLOOD_HUNGER: %d ]",
+          contract.rank, contract.request.header.timestamp, contract.request.bloodHunger);
+    }
   }
 
   if (myPosition >= firstUnemployed) {
@@ -249,118 +378,148 @@ int Gnome::findSwapCandidate() {
   if (maxPoisonAvailable <= 0 || swordsNeeded > swordsTotal) {
     return rank;
   }
-  auto swapWith = std::find_if(
-      std::next(positionInArmoryQueue), armoryQueue.end(),
-      [this, maxPoisonAvailable](const auto &item) {
-        return getContractById(item.request.contractId).numberOfHamsters <= maxPoisonAvailable;
-      });
+  // the first one behind this gnome that fits
+  const auto &own = armoryQueue.front();
+  auto swapWith = armoryQueue.end();
+  for (auto item = std::next(armoryQueue.begin()); item != armoryQueue.end(); ++item) {
+    if (own < *item && (swapWith == armoryQueue.end() || *item < *swapWith) &&
+        getContractById(item->request.contractId).numberOfHamsters <= maxPoisonAvailable &&
+        !isArmed(item->rank)) {
+      swapWith = item;
+    }
+  }
   if (swapWith == armoryQueue.end()) {
     return rank;
   }
-  log("Initiating swap with %d, he has %d hamsters to kill, and I have %d",
+  LOG(INFO, "Initiating swap with %d, he has %d hamsters to kill, and I have %d",
       swapWith->rank, getContractById(swapWith->request.contractId).numberOfHamsters,
       getContractById(currentContractId).numberOfHamsters);
   return swapWith->rank;
 }
 
 void Gnome::applySwap(const Swap &swap) {
-  auto swap1 = std::find_if(
+  // the delegated gnome takes armor as it sends a swap
+  armedRanks.push_back(swap.delegatedRank);
+  auto delegating = std::find_if(
       armoryQueue.begin(), armoryQueue.end(),
       [swap](const auto &item) { return item.rank == swap.delegatingRank; });
-  auto swap2 = std::find_if(
-      armoryQueue.begin(), armoryQueue.end(),
-      [swap](const auto &item) { return item.rank == swap.delegatedRank; });
-  if (swap1 < positionInArmoryQueue && positionInArmoryQueue < swap2) {
-    auto difference = getContractById(swap1->request.contractId).numberOfHamsters -
-                      getContractById(swap2->request.contractId).numberOfHamsters;
-    poisonNeeded -= difference;
-  } else if (swap.delegatingRank == rank) {
-    for (auto it = std::next(positionInArmoryQueue); it <= swap2; ++it) {
-      poisonNeeded += getContractById(it->request.contractId).numberOfHamsters;
-    }
-    positionInArmoryQueue = swap2;
+  if (delegating == armoryQueue.end()) {
+    swapQueue.push_back(swap);
+    return;
   }
+  delegating->moveBackTo(swap.placeTimestamp, swap.placeRank);
+}
 
-  std::swap(*swap1, *swap2);
+bool Gnome::isArmed(int gnomeRank) const {
+  return std::find(armedRanks.begin(), armedRanks.end(), gnomeRank) != armedRanks.end();
 }
 
-void Gnome::handleRequestForArmor(const MessageBase *message, const mpl::status &status) {
-  auto &request = *static_cast<const RequestForArmor *>(message);
-  if (request.contractId < minValidContractId) return;
-  log("Received REQUEST_FOR_ARMOR from GNOME %d", status.source());
-  ArmoryAllocationItem queueItem(status.source(), request);
-  armoryQueue.push_back(queueItem);
-
-  if ((*positionInArmoryQueue) < queueItem) {
-    auto contractId = queueItem.request.contractId;
-    swordsNeeded--;
-    poisonNeeded -= getContractById(contractId).numberOfHamsters;
-    log("Updated my resource requirements: swords_needed = %d, poison_kits_needed = %d",
-        swordsNeeded, poisonNeeded);
+// Counts what the gnomes before this one and the armed ones hold until they
+// complete, and whatever this gnome has not heard the request of yet.
+void Gnome::countArmorNeeded() {
+  const auto &own = armoryQueue.front();
+  swordsNeeded = 0;
+  poisonNeeded = 0;
+  for (const auto &contract : contracts) {
+    if (completedContracts[contract.contractId - minValidContractId]) continue;
+    auto item = std::find_if(
+        armoryQueue.begin(), armoryQueue.end(),
+        [&contract](const auto &item) { return item.request.contractId == contract.contractId; });
+    if (item != armoryQueue.end() && own < *item && !isArmed(item->rank)) continue;
+    swordsNeeded++;
+    poisonNeeded += contract.numberOfHamsters;
   }
+}
 
-  // If armory queue is complete, sort it and apply deferred swaps
-  if (armoryQueue.size() == contracts.size()) {
-    std::sort(armoryQueue.begin(), armoryQueue.end());
-    for (auto swap : swapQueue) {
-      applySwap(swap);
-    }
-    swapQueue.clear();
-    // Print armory queue
-    log("Armory queue:");
-    for (const auto &item : armoryQueue) {
-      log("[ CLOCK: %2d; RANK: %2d; CONTRACT_ID: %2d; NUM_HAMSTERS: %2d ]",
-          item.request.timestamp, item.rank, item.request.contractId,
+void Gnome::handleRequestForArmor(const MessageEnvelope &envelope) {
+  auto &request = envelope.get<RequestForArmor>();
+  if (request.contractId < minValidContractId) return;
+  LOG(DEBUG, "Received REQUEST_FOR_ARMOR from GNOME %d", envelope.status.source());
+  enqueueArmorRequest(envelope.status.source(), request);
+}
+
+void Gnome::enqueueArmorRequest(int gnomeRank, const RequestForArmor &request) {
+  armoryQueue.emplace_back(gnomeRank, request);
+  auto &queueItem = armoryQueue.back();
+  for (const auto &swap : swapQueue) {
+    if (swap.delegatingRank == gnomeRank) queueItem.moveBackTo(swap.placeTimestamp, swap.placeRank);
+  }
+  countArmorNeeded();
+  LOG(DEBUG, "Updated my resource requirements: swords_needed = %d, poison_kits_needed = %d",
+      swordsNeeded, poisonNeeded);
+
+  if (armoryQueue.size() < contracts.size()) return;
+  // Print armory queue
+  if (isLogged<LogLevel::TRACE>()) {
+    auto sortedQueue = armoryQueue;
+    std::sort(sortedQueue.begin(), sortedQueue.end());
+    LOG(TRACE, "Armory queue:");
+    for (const auto &item : sortedQueue) {
+      LOG(TRACE, "[ CLOCK: %2d; RANK: %2d; CONTRACT_ID: %2d; NUM_HAMSTERS: %2d ]",
+          item.request.header.timestamp, item.rank, item.request.contractId,
           getContractById(item.request.contractId).numberOfHamsters);
     }
-
-    positionInArmoryQueue =
-        std::find_if(armoryQueue.begin(), armoryQueue.end(),
-                     [=](const auto &item) { return item.rank == rank; });
-
-    log("My position in armory_queue = %d, swords_needed = %d, poison_kits_needed = %d",
-        std::distance(armoryQueue.begin(), positionInArmoryQueue), swordsNeeded, poisonNeeded);
   }
+  const auto &own = armoryQueue.front();
+  LOG(DEBUG, "My position in armory_queue = %d, swords_needed = %d, poison_kits_needed = %d",
+      static_cast<int>(std::count_if(armoryQueue.begin(), armoryQueue.end(),
+                                     [&own](const auto &item) { return item < own; })),
+      swordsNeeded, poisonNeeded);
 }
 
-void Gnome::handleContractCompleted(const MessageBase *message, const mpl::status &status) {
-  auto &report = *static_cast<const ContractCompleted *>(message);
+void Gnome::handleContractCompleted(const MessageEnvelope &envelope) {
+  auto &report = envelope.get<ContractCompleted>();
   auto contractId = report.contractId;
   if (contractId < minValidContractId) return;
-  log("Received CONTRACT_COMPLETED from GNOME %d.", status.source());
-  swordsNeeded--;
-  poisonNeeded -= getContractById(contractId).numberOfHamsters;
+  LOG(DEBUG, "Received CONTRACT_COMPLETED from GNOME %d.", envelope.status.source());
+  completedContracts[contractId - minValidContractId] = true;
+  countArmorNeeded();
 }
 
-void Gnome::handleSwap(const MessageBase *message, const mpl::status &status) {
-  log("Received SWAP from GNOME %d.", status.source());
-  auto &swap = *static_cast<const Swap *>(message);
-  if (armoryQueue.size() < contracts.size()) {
-    swapQueue.push_back(swap);
-    return;
-  }
-  applySwap(swap);
+void Gnome::handleSwap(const MessageEnvelope &envelope) {
+  LOG(DEBUG, "Received SWAP from GNOME %d.", envelope.status.source());
+  applySwap(envelope.get<Swap>());
+  countArmorNeeded();
+}
+
+void Gnome::handleDelegatePriority(const MessageEnvelope &envelope) {
+  LOG(DEBUG, "Received DELEGATE_PRIORITY from GNOME %d.", envelope.status.source());
+  acceptDelegation(envelope.status.source());
 }
 
-void Gnome::handleDelegatePriority(const mpl::status &status) {
-  log("Received DELEGATE_PRIORITY from GNOME %d.", status.source());
-  auto swap = Swap(status.source(), rank);
+void Gnome::acceptDelegation(int delegatingRank) {
+  const auto &own = armoryQueue.front();
+  auto swap = Swap(delegatingRank, rank, own.placeTimestamp, own.placeRank);
   broadcast(swap, SWAP);
-  state = RAMPAGE;
+  countArmoryFanOut();
+  startRampage();
+}
+
+void Gnome::handleDelegatePriorityDelegating(const MessageEnvelope &envelope) {
+  LOG(DEBUG, "Received DELEGATE_PRIORITY from GNOME %d.", envelope.status.source());
+  // the swap answers any later ones as well
+  if (postponedDelegatingRank == -1) postponedDelegatingRank = envelope.status.source();
 }
 
-void Gnome::handleSwapDelegating(const MessageBase *message, const mpl::status &status) {
-  log("Received SWAP from GNOME %d.", status.source());
-  auto &swap = *static_cast<const Swap *>(message);
-  applySwap(swap);
-  if ((swap.delegatedRank == swapRank) || (swap.delegatingRank == swapRank)) {
+void Gnome::handleSwapDelegating(const MessageEnvelope &envelope) {
+  auto &swap = envelope.get<Swap>();
+  handleSwap(envelope);
+  // when it delegates on instead, it still answers once that is settled
+  if (swap.delegatedRank == swapRank) {
     state = TAKING_INVENTORY;
   }
 }
 
-void Gnome::handleAllocateArmorDelegating(const MessageBase *message, const mpl::status &status) {
-  log("Received ALLOCATE_ARMOR from GNOME %d.", status.source());
-  if (status.source() == swapRank) {
+void Gnome::handleAllocateArmor(const MessageEnvelope &envelope) {
+  LOG(DEBUG, "Received ALLOCATE_ARMOR from GNOME %d.", envelope.status.source());
+  armedRanks.push_back(envelope.status.source());
+  countArmorNeeded();
+}
+
+void Gnome::handleAllocateArmorDelegating(const MessageEnvelope &envelope) {
+  handleAllocateArmor(envelope);
+  // it went ahead on its own, which moves nobody
+  if (envelope.status.source() == swapRank) {
     state = TAKING_INVENTORY;
   }
 }
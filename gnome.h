@@ -1,6 +1,11 @@
 #ifndef GNOME_H_
 #define GNOME_H_
 
+#include <chrono>
+
+#include "armory.h"
+#include "contract_board.h"
+#include "contract_broadcast.h"
 #include "mpi_types.h"
 #include "process_base.h"
 
@@ -18,21 +23,35 @@ struct ContractQueueItem {
   }
 };
 
+// Gnomes take armor in the order of their places. A place starts at the
+// request's and only ever moves back, to the place of a gnome it delegated
+// its priority to, so swaps give the same order whichever way they arrive.
 struct ArmoryAllocationItem {
   int rank;
   struct RequestForArmor request;
+  int placeTimestamp;
+  int placeRank;
 
   ArmoryAllocationItem() = default;
   ArmoryAllocationItem(const int rank, const RequestForArmor& request)
-      : rank(rank), request(request) {}
+      : rank(rank),
+        request(request),
+        placeTimestamp(request.header.timestamp),
+        placeRank(rank) {}
+
+  bool isBefore(int timestamp, int otherRank) const {
+    return (placeTimestamp == timestamp) ? (placeRank < otherRank)
+                                         : (placeTimestamp < timestamp);
+  }
 
-  bool operator<(const ArmoryAllocationItem& rhs) const {
-    return (request == rhs.request) ? (rank < rhs.rank)
-                                    : (request < rhs.request);
+  void moveBackTo(int timestamp, int otherRank) {
+    if (!isBefore(timestamp, otherRank)) return;
+    placeTimestamp = timestamp;
+    placeRank = otherRank;
   }
 
-  bool operator==(const ArmoryAllocationItem& rhs) const {
-    return (rank == rhs.rank && request == rhs.request);
+  bool operator<(const ArmoryAllocationItem& rhs) const {
+    return isBefore(rhs.placeTimestamp, rhs.placeRank);
   }
 };
 
@@ -47,6 +66,8 @@ class Gnome : public ProcessBase {
     FINISH
   };
   const int numberOfGnomes;
+  const mpl::communicator& gnomeCommunicator;
+  std::vector<int> gnomeRanks;  // world rank of each gnome communicator rank
 
   GnomeState state;
   int bloodHunger;
@@ -56,38 +77,78 @@ class Gnome : public ProcessBase {
   int currentContractId;
   int swapRank;
   std::vector<Contract> contracts;
+  std::vector<RequestForContract> contractRequests;
   std::vector<ContractQueueItem> contractQueue;
-  std::vector<ArmoryAllocationItem> armoryQueue;
-  std::vector<ArmoryAllocationItem>::iterator positionInArmoryQueue;
-  std::vector<Swap> swapQueue;
+  std::vector<ArmoryAllocationItem> armoryQueue;  // this gnome's own item first
+  std::vector<RequestForArmor> armorRequests;
+  std::vector<Swap> swapQueue;  // swaps of gnomes whose request is still on the way
+  std::vector<int> armedRanks;  // took armor this round, too late to delegate to
+  std::vector<bool> completedContracts;  // by contract id from minValidContractId
+  int postponedDelegatingRank;  // asked this gnome first while it delegated, -1 for none
+  std::unique_ptr<Armory> armory;  // none for the message protocol
+  std::unique_ptr<ContractBoard> contractBoard;
+  std::unique_ptr<ContractBroadcast> contractBroadcast;
+
+  std::chrono::steady_clock::time_point inventoryStart;
+  std::chrono::steady_clock::time_point rampageDeadline;
+  double allocationMilliseconds = 0;
+  int allocations = 0;
+  unsigned long armoryMessages = 0;  // sent by the message protocol
 
   void doPeaceIsALie();
   void doGatherParty();
   void doTakingInventory();
   void doDelegatingPriority();
+  // the state that keeps handling messages until its deadline
   void doRampage();
+  void startRampage();
+  // one message to every other employed gnome
+  void countArmoryFanOut() { armoryMessages += contracts.size() - 1; }
 
   const Contract& getContractById(int id) const;
-  std::vector<int> getAllGnomeRanks() const;
   std::vector<int> getEmployedGnomeRanks() const;
   bool getContract();
   int findSwapCandidate();
   void applySwap(const Swap& swap);
+  bool isArmed(int gnomeRank) const;
+  void countArmorNeeded();
+  void startArmoryQueue(const RequestForArmor& request);
+  void exchangeArmorRequests(bool employed);
+  void enqueueArmorRequest(int gnomeRank, const RequestForArmor& request);
+
+  void handleRequestForArmor(const MessageEnvelope& envelope);
+  void handleContractCompleted(const MessageEnvelope& envelope);
+  void handleSwap(const MessageEnvelope& envelope);
+  void handleDelegatePriority(const MessageEnvelope& envelope);
+
+  void acceptDelegation(int delegatingRank);
 
-  void handleRequestForArmor(const MessageBase* message, const mpl::status& status);
-  void handleContractCompleted(const MessageBase* message, const mpl::status& status);
-  void handleSwap(const MessageBase* message, const mpl::status& status);
-  void handleDelegatePriority(const mpl::status &status);
+  void handleDelegatePriorityDelegating(const MessageEnvelope& envelope);
+  void handleSwapDelegating(const MessageEnvelope& envelope);
+  void handleAllocateArmor(const MessageEnvelope& envelope);
+  void handleAllocateArmorDelegating(const MessageEnvelope& envelope);
 
-  void handleSwapDelegating(const MessageBase* message, const mpl::status& status);
-  void handleAllocateArmorDelegating(const MessageBase* message, const mpl::status& status);
+  static const HandlerTable<Gnome> takingInventoryHandlers;
+  static const HandlerTable<Gnome> delegatingPriorityHandlers;
+  static const HandlerTable<Gnome> rampageHandlers;
 
  public:
   static int swordsTotal;
   static int poisonTotal;
+  static const int armoryRetryMicroseconds;
+  static const int rampageSliceMicroseconds;  // longest sleep between polls
+  static bool useNeighborCollectives;
 
-  explicit Gnome(const mpl::communicator& communicator);
+  Gnome(const mpl::communicator& communicator, const mpl::communicator& gnomeCommunicator);
   void run(int maxRounds) override;
+
+  // time from asking for armor until the rampage starts
+  double getAverageAllocationLatency() const;
+  int getAllocations() const { return allocations; }
+  // messages to other gnomes for taking and returning armor
+  unsigned long getArmoryMessages() const {
+    return armory ? armory->getSentMessages() : armoryMessages;
+  }
 };
 
 #endif  // GNOME_H_
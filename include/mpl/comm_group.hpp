@@ -15,6 +15,8 @@ namespace mpl {
 
   class communicator;
 
+  class window;
+
   class cart_communicator;
 
   class graph_communicator;
@@ -375,6 +377,8 @@ namespace mpl {
 
     friend class dist_graph_communicator;
 
+    friend class window;
+
     friend class environment::detail::env;
 
     // === point to point ==============================================
@@ -1282,8 +1286,60 @@ namespace mpl {
 
     // === matching receive ===
     // --- blocking matching receive ---
+    template<typename T>
+    status mrecv(T &data, message &m) const {
+      status s;
+      MPI_Mrecv(&data, 1, datatype_traits<T>::get_datatype(), &m,
+                reinterpret_cast<MPI_Status *>(&s));
+      return s;
+    }
+
+    template<typename T>
+    status mrecv(T *data, const layout<T> &l, message &m) const {
+      status s;
+      MPI_Mrecv(data, 1, datatype_traits<layout<T>>::get_datatype(l), &m,
+                reinterpret_cast<MPI_Status *>(&s));
+      return s;
+    }
+
+    template<typename iterT>
+    status mrecv(iterT begin, iterT end, message &m) const {
+      using value_type = typename std::iterator_traits<iterT>::value_type;
+      if (detail::is_contiguous_iterator<iterT>::value) {
+        vector_layout<value_type> l(std::distance(begin, end));
+        return mrecv(&(*begin), l, m);
+      } else {
+        iterator_layout<value_type> l(begin, end);
+        return mrecv(&(*begin), l, m);
+      }
+    }
 
     // --- nonblocking matching receive ---
+    template<typename T>
+    irequest imrecv(T &data, message &m) const {
+      MPI_Request req;
+      MPI_Imrecv(&data, 1, datatype_traits<T>::get_datatype(), &m, &req);
+      return detail::irequest(req);
+    }
+
+    template<typename T>
+    irequest imrecv(T *data, const layout<T> &l, message &m) const {
+      MPI_Request req;
+      MPI_Imrecv(data, 1, datatype_traits<layout<T>>::get_datatype(l), &m, &req);
+      return detail::irequest(req);
+    }
+
+    template<typename iterT>
+    irequest imrecv(iterT begin, iterT end, message &m) const {
+      using value_type = typename std::iterator_traits<iterT>::value_type;
+      if (detail::is_contiguous_iterator<iterT>::value) {
+        vector_layout<value_type> l(std::distance(begin, end));
+        return imrecv(&(*begin), l, m);
+      } else {
+        iterator_layout<value_type> l(begin, end);
+        return imrecv(&(*begin), l, m);
+      }
+    }
 
     // === send and receive ===
     // --- send and receive ---
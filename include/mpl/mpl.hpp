@@ -37,6 +37,7 @@ namespace mpl {
 #include <mpl/operator.hpp>
 #include <mpl/request.hpp>
 #include <mpl/comm_group.hpp>
+#include <mpl/window.hpp>
 #include <mpl/environment.hpp>
 #include <mpl/topo_comm.hpp>
 #include <mpl/cart_comm.hpp>
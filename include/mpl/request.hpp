@@ -307,6 +307,8 @@ namespace mpl {
 
     prequest_pool(prequest_pool &&r) noexcept : base(std::move(r)) {}
 
+    void start(size_type i) { MPI_Start(&reqs[i]); }
+
     void startall() { MPI_Startall(size(), &reqs[0]); }
   };
 
@@ -0,0 +1,174 @@
+#if !(defined MPL_WINDOW_HPP)
+
+#define MPL_WINDOW_HPP
+
+#include <mpi.h>
+#include <cstddef>
+
+namespace mpl {
+
+  // replaces the target value, for accumulate and fetch_and_op
+  template<typename T>
+  struct replace {};
+
+  // leaves the target value untouched, for an atomic read with fetch_and_op
+  template<typename T>
+  struct no_op {};
+
+  namespace detail {
+
+    // one-sided operations only accept predefined reduction operations
+    template<typename F>
+    struct rma_op_traits;
+
+    template<typename T>
+    struct rma_op_traits<plus<T>> {
+      static MPI_Op get() { return MPI_SUM; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<max<T>> {
+      static MPI_Op get() { return MPI_MAX; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<min<T>> {
+      static MPI_Op get() { return MPI_MIN; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<bit_and<T>> {
+      static MPI_Op get() { return MPI_BAND; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<bit_or<T>> {
+      static MPI_Op get() { return MPI_BOR; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<bit_xor<T>> {
+      static MPI_Op get() { return MPI_BXOR; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<replace<T>> {
+      static MPI_Op get() { return MPI_REPLACE; }
+    };
+
+    template<typename T>
+    struct rma_op_traits<no_op<T>> {
+      static MPI_Op get() { return MPI_NO_OP; }
+    };
+
+  }  // namespace detail
+
+  //--------------------------------------------------------------------
+
+  class window {
+    MPI_Win win{MPI_WIN_NULL};
+
+  public:
+    enum class lock_type { exclusive = MPI_LOCK_EXCLUSIVE, shared = MPI_LOCK_SHARED };
+
+    // Collective over comm. Exposes count elements of type T starting at
+    // base; displacements in one-sided operations count elements of T.
+    template<typename T>
+    window(const communicator &comm, T *base, size_t count) {
+      MPI_Win_create(base, static_cast<MPI_Aint>(count * sizeof(T)), sizeof(T), MPI_INFO_NULL,
+                     comm.comm, &win);
+    }
+
+    window(const window &) = delete;
+
+    window(window &&other) noexcept : win(other.win) { other.win = MPI_WIN_NULL; }
+
+    ~window() {
+      if (win != MPI_WIN_NULL) MPI_Win_free(&win);
+    }
+
+    void operator=(const window &) = delete;
+
+    // === synchronization ===
+    // --- active target ---
+    void fence(int assert = 0) const { MPI_Win_fence(assert, win); }
+
+    // --- passive target ---
+    void lock(int rank, lock_type type = lock_type::exclusive, int assert = 0) const {
+      MPI_Win_lock(static_cast<int>(type), rank, assert, win);
+    }
+
+    void unlock(int rank) const { MPI_Win_unlock(rank, win); }
+
+    void lock_all(int assert = 0) const { MPI_Win_lock_all(assert, win); }
+
+    void unlock_all() const { MPI_Win_unlock_all(win); }
+
+    void flush(int rank) const { MPI_Win_flush(rank, win); }
+
+    void flush_all() const { MPI_Win_flush_all(win); }
+
+    void sync() const { MPI_Win_sync(win); }
+
+    // === data movement ===
+    template<typename T>
+    void put(const T &data, int target, std::ptrdiff_t displacement = 0) const {
+      MPI_Put(&data, 1, datatype_traits<T>::get_datatype(), target, displacement, 1,
+              datatype_traits<T>::get_datatype(), win);
+    }
+
+    template<typename T>
+    void put(const T *data, const layout<T> &l, int target,
+             std::ptrdiff_t displacement = 0) const {
+      MPI_Put(data, 1, datatype_traits<layout<T>>::get_datatype(l), target, displacement, 1,
+              datatype_traits<layout<T>>::get_datatype(l), win);
+    }
+
+    template<typename T>
+    void get(T &data, int target, std::ptrdiff_t displacement = 0) const {
+      MPI_Get(&data, 1, datatype_traits<T>::get_datatype(), target, displacement, 1,
+              datatype_traits<T>::get_datatype(), win);
+    }
+
+    template<typename T>
+    void get(T *data, const layout<T> &l, int target, std::ptrdiff_t displacement = 0) const {
+      MPI_Get(data, 1, datatype_traits<layout<T>>::get_datatype(l), target, displacement, 1,
+              datatype_traits<layout<T>>::get_datatype(l), win);
+    }
+
+    // === atomics ===
+    // value must be of a predefined datatype. The operations complete at the
+    // target before they return, since value may be a temporary and result is
+    // undefined until then, so they need a passive-target epoch.
+    template<typename T, typename F>
+    T fetch_and_op(const T &value, F, int target, std::ptrdiff_t displacement = 0) const {
+      T result;
+      MPI_Fetch_and_op(&value, &result, datatype_traits<T>::get_datatype(), target, displacement,
+                       detail::rma_op_traits<F>::get(), win);
+      flush(target);
+      return result;
+    }
+
+    template<typename T, typename F>
+    void accumulate(const T &value, F, int target, std::ptrdiff_t displacement = 0) const {
+      MPI_Accumulate(&value, 1, datatype_traits<T>::get_datatype(), target, displacement, 1,
+                     datatype_traits<T>::get_datatype(), detail::rma_op_traits<F>::get(), win);
+      flush(target);
+    }
+
+    // returns the target value before the operation, value was stored if it
+    // equals compare
+    template<typename T>
+    T compare_and_swap(const T &value, const T &compare, int target,
+                       std::ptrdiff_t displacement = 0) const {
+      T result;
+      MPI_Compare_and_swap(&value, &compare, &result, datatype_traits<T>::get_datatype(), target,
+                           displacement, win);
+      flush(target);
+      return result;
+    }
+  };
+
+}  // namespace mpl
+
+#endif
@@ -1,5 +1,7 @@
+#include <chrono>
 #include <random>
 
+#include "gnome.h"
 #include "landlord.h"
 #include "mpi_types.h"
 
@@ -15,15 +17,29 @@ int Landlord::maxHamstersPerContract = 20;
 Landlord::Landlord(const mpl::communicator& communicator)
     : ProcessBase(communicator, "LANDLORD"),
       minValidContractId(0),
-      numberOfGnomes(communicator.size() - 1) {}
+      nextContractsReady(false),
+      numberOfGnomes(communicator.size() - 1),
+      completedContracts(0) {
+  if (RmaArmory::enabled) {
+    rmaArmory.reset(
+        new RmaArmory(communicator, landlordRank, Gnome::swordsTotal, Gnome::poisonTotal));
+  }
+  if (ContractBoard::enabled) {
+    contractBoard.reset(new ContractBoard(communicator, landlordRank, numberOfGnomes));
+  } else if (ContractBroadcast::enabled) {
+    contractBroadcast.reset(new ContractBroadcast(communicator, landlordRank, numberOfGnomes));
+  }
+}
 
 void Landlord::run(int maxRounds) {
-  log("I'm alive!");
+  LOG(INFO, "I'm alive!");
 
   state = HIRE;
   int round = 0;
+  auto start = std::chrono::steady_clock::now();
 
   while (round != maxRounds) {
+    traceState(state);
     switch (state) {
       case HIRE: {
         doHire();
@@ -40,35 +56,74 @@ void Landlord::run(int maxRounds) {
       }
       default: {
         // Should never reach here
-        log("Entered superposition state. Committing suicide.");
+        LOG(WARNING, "Entered superposition state. Committing suicide.");
         return;
       }
     }
+    if (contractBroadcast) contractBroadcast->progress();
   }
-  log("My mission in this world completed. Committing suicide.");
+  logStatistics();
+  logThroughput(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+  LOG(INFO, "My mission in this world completed. Committing suicide.");
 }
 
-void Landlord::doHire() {
-  minValidContractId += contracts.size();
-  contracts.clear();
+void Landlord::logThroughput(double realSeconds) const {
+  // the protocol's own cost, which is all of it with virtual time
+  LOG(INFO, "Completed %d contracts in %.3f s of real time, %.1f contracts/s",
+      completedContracts, realSeconds, realSeconds > 0 ? completedContracts / realSeconds : 0.0);
+  if (!useVirtualTime) return;
+  double simulatedSeconds = getVirtualTime() / 1e3;
+  LOG(INFO, "Completed %d contracts in %.3f s of simulated time, %.3f contracts/s",
+      completedContracts, simulatedSeconds,
+      simulatedSeconds > 0 ? completedContracts / simulatedSeconds : 0.0);
+}
+
+void Landlord::generateContracts(std::vector<Contract>& wave, int firstContractId) {
+  wave.clear();
   int numberOfContracts = randomInt(1, numberOfGnomes);
 
   // Generate random contracts
-  for (int i = 0, contractId = minValidContractId; i < numberOfContracts; ++i) {
+  for (int i = 0, contractId = firstContractId; i < numberOfContracts; ++i) {
     int numberOfHamsters =
         randomInt(minHamstersPerContract, maxHamstersPerContract);
-    log("I have new contract: [ ID: %d, NUM_HAMSTERS: %d ]", contractId, numberOfHamsters);
-    contracts.emplace_back(contractId++, numberOfHamsters);
+    LOG(DEBUG, "I have new contract: [ ID: %d, NUM_HAMSTERS: %d ]", contractId, numberOfHamsters);
+    wave.emplace_back(contractId++, numberOfHamsters);
   }
+}
+
+void Landlord::doHire() {
+  advanceEpoch();
+  minValidContractId += contracts.size();
+  if (nextContractsReady) {
+    contracts.swap(nextContracts);
+    nextContractsReady = false;
+  } else {
+    generateContracts(contracts, minValidContractId);
+  }
+  int numberOfContracts = contracts.size();
   isCompleted.resize(numberOfContracts);
   std::fill(isCompleted.begin(), isCompleted.end(), false);
-  log("Total number of contracts in this wave: %d", numberOfContracts);
+  LOG(INFO, "Total number of contracts in this wave: %d", numberOfContracts);
 
   // Send contracts to gnomes
-  log("Broadcasting contract list.");
-  broadcastVector(contracts, CONTRACTS);
+  if (contractBoard) {
+    LOG(DEBUG, "Publishing contract list on the board.");
+    stampOutgoing(contracts);
+    contractBoard->publish(contracts);
+  } else if (contractBroadcast) {
+    LOG(DEBUG, "Starting the contract list broadcast.");
+    stampOutgoing(contracts);
+    contractBroadcast->publish(contracts);
+    // the next wave is ready as soon as this one is done with
+    generateContracts(nextContracts, minValidContractId + contracts.size());
+    nextContractsReady = true;
+  } else {
+    LOG(DEBUG, "Broadcasting contract list.");
+    broadcastVector(contracts, CONTRACTS);
+  }
 
-  state = READ_GANDHI;
+  // nobody is going to report back on an empty wave
+  state = contracts.empty() ? FINISH : READ_GANDHI;
 }
 
 void Landlord::doReadGandhi() {
@@ -76,7 +131,8 @@ void Landlord::doReadGandhi() {
   const auto& status = receiveAny(message, CONTRACT_COMPLETED);
   int contractId = message.contractId;
   isCompleted[contractId - minValidContractId] = true;
-  log("I was informed that GNOME %d has murdered all %d hamsters and so completed his contract (ID : %d)",
+  completedContracts++;
+  LOG(INFO, "I was informed that GNOME %d has murdered all %d hamsters and so completed his contract (ID : %d)",
       status.source(), contracts[contractId - minValidContractId].numberOfHamsters, contractId);
 
   if (std::all_of(isCompleted.begin(), isCompleted.end(), [](bool completed) { return completed; })) {
@@ -1,8 +1,11 @@
 #ifndef LANDLORD_H_
 #define LANDLORD_H_
 
+#include "contract_board.h"
+#include "contract_broadcast.h"
 #include "mpi_types.h"
 #include "process_base.h"
+#include "rma_armory.h"
 
 class Landlord : public ProcessBase {
  private:
@@ -11,11 +14,19 @@ class Landlord : public ProcessBase {
 
   LandlordState state;
   std::vector<Contract> contracts;
+  std::vector<Contract> nextContracts;  // generated while the current wave goes out
+  bool nextContractsReady;
   std::vector<bool> isCompleted;
   int minValidContractId;
+  int completedContracts;
+  std::unique_ptr<RmaArmory> rmaArmory;  // hosted here, only gnomes touch it
+  std::unique_ptr<ContractBoard> contractBoard;
+  std::unique_ptr<ContractBroadcast> contractBroadcast;
 
+  void generateContracts(std::vector<Contract>& wave, int firstContractId);
   void doHire();
   void doReadGandhi();
+  void logThroughput(double realSeconds) const;
 
  public:
   static const int landlordRank;
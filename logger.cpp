@@ -0,0 +1,100 @@
+#include "logger.h"
+
+#include <chrono>
+
+std::string Logger::filePrefix;
+bool Logger::synchronous = false;
+size_t Logger::capacity = 4096;
+LogLevel Logger::verbosity = LogLevel::TRACE;
+
+namespace {
+
+const char* const levelNames[] = {"trace", "debug", "info", "warning"};
+
+// how long the flusher sleeps when there is nothing to write
+const auto idlePeriod = std::chrono::milliseconds(1);
+
+}  // namespace
+
+bool Logger::getLevel(const std::string& name, LogLevel& level) {
+  for (size_t index = 0; index < sizeof(levelNames) / sizeof(levelNames[0]); index++) {
+    if (name == levelNames[index]) {
+      level = static_cast<LogLevel>(index);
+      return true;
+    }
+  }
+  return false;
+}
+
+Logger::Logger(int rank, const char* role)
+    : rank(rank),
+      role(role),
+      file(stdout),
+      colored(filePrefix.empty()),
+      records(synchronous ? 1 : capacity) {
+  if (!filePrefix.empty()) {
+    std::string path = filePrefix + std::to_string(rank) + ".log";
+    file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+      fprintf(stderr, "[Rank: %2d] Cannot open %s, logging to stdout\n", rank, path.c_str());
+      file = stdout;
+    }
+  }
+  if (!synchronous) flusher = std::thread(&Logger::flushLoop, this);
+}
+
+Logger::~Logger() {
+  if (flusher.joinable()) {
+    stopFlusher = true;
+    flusher.join();
+  }
+  reportDrops();
+  if (file != stdout) {
+    fclose(file);
+  } else {
+    fflush(file);
+  }
+}
+
+void Logger::writeRecord(const Record& record) {
+  if (colored) {
+    fprintf(file, "%c[%d;%dm [Rank: %2d] [Clock: %3d] [%s] ", 27, (1 + (rank / 7)) % 2,
+            31 + (6 + rank) % 7, rank, record.clock, role);
+  } else {
+    fprintf(file, " [Rank: %2d] [Clock: %3d] [%s] ", rank, record.clock, role);
+  }
+  record.write(record, file);
+  if (colored) {
+    fprintf(file, "%c[%d;%dm\n", 27, 0, 37);
+  } else {
+    fputc('\n', file);
+  }
+}
+
+void Logger::reportDrops() {
+  unsigned long dropped = droppedRecords;
+  if (dropped == reportedDrops) return;
+  fprintf(file, " [Rank: %2d] [%s] Log ring full, dropped %lu records\n", rank, role,
+          dropped - reportedDrops);
+  reportedDrops = dropped;
+}
+
+void Logger::flushLoop() {
+  Record record;
+  while (true) {
+    // read first, so the drain below sees everything logged before the stop
+    bool stopping = stopFlusher;
+    bool idle = true;
+    while (records.pop(record)) {
+      writeRecord(record);
+      idle = false;
+    }
+    // reported where the gap is, between the records around it
+    reportDrops();
+    if (idle) {
+      if (stopping) break;
+      fflush(file);
+      std::this_thread::sleep_for(idlePeriod);
+    }
+  }
+}
@@ -0,0 +1,115 @@
+#ifndef LOGGER_H_
+#define LOGGER_H_
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+#include "spsc_queue.h"
+
+enum class LogLevel { TRACE, DEBUG, INFO, WARNING };
+
+// levels below this are compiled out, set through the MIN_LOG_LEVEL CMake option
+#ifndef MIN_LOG_LEVEL
+#define MIN_LOG_LEVEL TRACE
+#endif
+constexpr LogLevel minLogLevel = LogLevel::MIN_LOG_LEVEL;
+
+// Log of one rank. A call copies the format pointer and its arguments into a
+// lock-free ring and returns, a background thread formats the records and
+// writes them out. When the ring is full records are dropped and counted
+// instead of stalling the caller. Only one thread may write to a logger, and
+// string arguments must outlive it, which literals do.
+class Logger {
+ private:
+  static const size_t maxArgumentBytes = 48;
+
+  struct Record;
+  using Writer = void (*)(const Record&, FILE*);
+
+  struct Record {
+    const char* format;
+    Writer write;
+    int clock;
+    unsigned char arguments[maxArgumentBytes];  // packed back to back
+  };
+
+  const int rank;
+  const char* role;
+  FILE* file;
+  bool colored;
+  SpscQueue<Record> records;
+  std::atomic<unsigned long> droppedRecords{0};
+  unsigned long reportedDrops = 0;
+  std::atomic<bool> stopFlusher{false};
+  std::thread flusher;
+
+  template <typename... Args>
+  static constexpr size_t getOffset(size_t index) {
+    size_t sizes[] = {sizeof(Args)..., 0};
+    size_t offset = 0;
+    for (size_t i = 0; i < index; i++) offset += sizes[i];
+    return offset;
+  }
+
+  template <typename T>
+  static T load(const unsigned char* bytes) {
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+  }
+
+  template <typename... Args, size_t... I>
+  static void writeUnpacked(const Record& record, FILE* file, std::index_sequence<I...>) {
+    fprintf(file, record.format, load<Args>(record.arguments + getOffset<Args...>(I))...);
+  }
+
+  template <typename... Args>
+  static void writeAs(const Record& record, FILE* file) {
+    writeUnpacked<Args...>(record, file, std::index_sequence_for<Args...>{});
+  }
+
+  void writeRecord(const Record& record);
+  void reportDrops();
+  void flushLoop();
+
+ public:
+  static std::string filePrefix;  // empty writes to stdout
+  static bool synchronous;        // format and write in the caller instead
+  static size_t capacity;         // records the ring holds
+  static LogLevel verbosity;      // levels below it are skipped at run time
+
+  // level named by its lowercase name, false for anything else
+  static bool getLevel(const std::string& name, LogLevel& level);
+
+  Logger(int rank, const char* role);
+  // writes out every record logged so far
+  ~Logger();
+
+  template <typename... Args>
+  void write(int clock, const char* format, const Args&... args) {
+    static_assert(getOffset<Args...>(sizeof...(Args)) <= maxArgumentBytes,
+                  "too many log arguments");
+    Record record;
+    record.format = format;
+    record.write = &writeAs<Args...>;
+    record.clock = clock;
+    unsigned char* out = record.arguments;
+    int expand[] = {0, (std::memcpy(out, &args, sizeof(Args)), out += sizeof(Args), 0)...};
+    (void)expand;
+    if (synchronous) {
+      writeRecord(record);
+    } else if (!records.push(std::move(record))) {
+      droppedRecords.store(droppedRecords.load(std::memory_order_relaxed) + 1,
+                           std::memory_order_relaxed);
+    }
+  }
+
+  unsigned long getDroppedRecords() const { return droppedRecords; }
+};
+
+#endif  // LOGGER_H_
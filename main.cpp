@@ -7,8 +7,8 @@
 #include "ascii_art.h"
 #include "gnome.h"
 #include "landlord.h"
-
-#define DEBUG
+#include "permission_armory.h"
+#include "rma_armory.h"
 
 void signal_callback_handler(int signum) {
   printf("[Rank: %d] (DEAD): I was wildly killed by unknown force.\n",
@@ -21,13 +21,39 @@ int main(int argc, char **argv) {
   Landlord::maxHamstersPerContract = config.maxHamstersPerContract;
   Gnome::swordsTotal = config.swordsTotal;
   Gnome::poisonTotal = config.poisonTotal;
+  ProcessBase::useEventLoop = config.eventLoop;
+  ProcessBase::maxFrameBytes = config.frameBytes;
+  ProcessBase::useProgressThread = config.progressThread;
+  ProcessBase::usePackedCodec = config.packedCodec;
+  ProcessBase::creditWindow = config.creditWindow;
+  ProcessBase::useBufferedSends = config.sendMode == "buffered";
+  RmaArmory::enabled = config.armoryEngine == "rma";
+  PermissionArmory::enabled = config.armoryEngine == "permissions";
+  ContractBoard::enabled = config.contractBoard;
+  ContractBroadcast::enabled = config.contractBroadcast;
+  Gnome::useNeighborCollectives = config.neighborCollectives;
+  Logger::filePrefix = config.logPrefix;
+  Logger::getLevel(config.verbosity, Logger::verbosity);
+  TraceWriter::filePrefix = config.tracePrefix;
+  ProcessBase::useVirtualTime = config.virtualTime;
+  // the armory engines have no room for the time armor was returned at
+  if (ProcessBase::useVirtualTime && config.armoryEngine != "messages") {
+    if (mpl::environment::comm_world().rank() == 0) {
+      fprintf(stderr, "Virtual time works with the message armory only.\n");
+    }
+    return EXIT_FAILURE;
+  }
 
   const mpl::communicator &comm_world(mpl::environment::comm_world());
+  // Gnomes negotiate contracts among themselves, the landlord stays out
+  const bool isLandlord = comm_world.rank() == Landlord::landlordRank;
+  mpl::communicator gnomeComm(mpl::communicator::split(), comm_world,
+                              isLandlord ? mpl::undefined : 1, comm_world.rank());
 
   signal(SIGINT, signal_callback_handler);
   signal(SIGTERM, signal_callback_handler);
 
-  if (comm_world.rank() == Landlord::landlordRank) {
+  if (isLandlord) {
     std::puts(header);
     printf("There are %d swords and %d poison kits available.\n",
            Gnome::swordsTotal, Gnome::poisonTotal);
@@ -35,7 +61,7 @@ int main(int argc, char **argv) {
     landlord.run(config.maxRounds);
   } else {
     usleep(1000);
-    Gnome gnome(comm_world);
+    Gnome gnome(comm_world, gnomeComm);
     gnome.run(config.maxRounds);
   }
 
@@ -0,0 +1,63 @@
+#ifndef MESSAGE_POOL_H_
+#define MESSAGE_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Fixed-size slots for one message type. Released slots go to a free list and
+// are handed out again, so the heap is only touched when the pool grows.
+template <typename T>
+class MessagePool {
+ private:
+  union Slot {
+    Slot* next;
+    alignas(T) unsigned char storage[sizeof(T)];
+  };
+
+  std::vector<std::unique_ptr<Slot[]>> chunks;
+  Slot* freeList = nullptr;
+  size_t nextChunkSize;
+  size_t chunkAllocations = 0;
+  size_t slotsInUse = 0;
+
+  void grow() {
+    chunks.emplace_back(new Slot[nextChunkSize]);
+    chunkAllocations++;
+    Slot* chunk = chunks.back().get();
+    for (size_t i = 0; i < nextChunkSize; i++) {
+      chunk[i].next = freeList;
+      freeList = &chunk[i];
+    }
+    nextChunkSize *= 2;
+  }
+
+ public:
+  explicit MessagePool(size_t initialChunkSize = 16) : nextChunkSize(initialChunkSize) {}
+
+  MessagePool(const MessagePool&) = delete;
+  MessagePool& operator=(const MessagePool&) = delete;
+
+  T* create(const T& message) {
+    if (freeList == nullptr) grow();
+    Slot* slot = freeList;
+    freeList = slot->next;
+    slotsInUse++;
+    return new (slot->storage) T(message);
+  }
+
+  void destroy(const T* message) {
+    message->~T();
+    Slot* slot = reinterpret_cast<Slot*>(const_cast<T*>(message));
+    slot->next = freeList;
+    freeList = slot;
+    slotsInUse--;
+  }
+
+  // number of times the pool had to go to the heap
+  size_t getChunkAllocations() const { return chunkAllocations; }
+  size_t getSlotsInUse() const { return slotsInUse; }
+};
+
+#endif  // MESSAGE_POOL_H_
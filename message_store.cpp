@@ -0,0 +1,75 @@
+#include "message_store.h"
+
+#include "mpi_types.h"
+
+void MessageStore::Bucket::dropTaken() {
+  while (!arrivals.empty() && arrivals.front().taken) {
+    arrivals.pop_front();
+    firstArrival++;
+  }
+}
+
+MessageStore::Entry* MessageStore::Bucket::front(int sourceRank) {
+  if (sourceRank == mpl::any_source) {
+    // entries taken by an exact lookup are dropped lazily
+    dropTaken();
+    return arrivals.empty() ? nullptr : &arrivals.front();
+  }
+  if (sourceRank >= bySource.size() || bySource[sourceRank].empty()) {
+    return nullptr;
+  }
+  return &at(bySource[sourceRank].front());
+}
+
+const MessageEnvelope* MessageStore::Bucket::take(int sourceRank) {
+  Entry* entry = front(sourceRank);
+  // the oldest entry of a tag is also the oldest one of its source
+  bySource[entry->source].pop_front();
+  entry->taken = true;
+  auto envelope = entry->envelope;
+  dropTaken();
+  return envelope;
+}
+
+MessageStore::Bucket* MessageStore::getBucket(mpl::tag tag) {
+  int index = static_cast<int>(tag);
+  if (index < 0 || index >= buckets.size()) return nullptr;
+  return &buckets[index];
+}
+
+void MessageStore::push(const MessageEnvelope* envelope) {
+  int index = envelope->type;
+  if (index >= buckets.size()) buckets.resize(index + 1);
+  Bucket& bucket = buckets[index];
+  int source = envelope->status.source();
+  if (source >= bucket.bySource.size()) bucket.bySource.resize(source + 1);
+
+  bucket.bySource[source].push_back(bucket.firstArrival + bucket.arrivals.size());
+  bucket.arrivals.push_back(Entry{nextSequence++, envelope, source, false});
+  count++;
+}
+
+const MessageEnvelope* MessageStore::pop(int sourceRank, mpl::tag tag) {
+  Bucket* bucket = getBucket(tag);
+  if (bucket == nullptr || bucket->front(sourceRank) == nullptr) return nullptr;
+  count--;
+  return bucket->take(sourceRank);
+}
+
+const MessageEnvelope* MessageStore::pop(int sourceRank, unsigned tagMask) {
+  // pick the oldest candidate among the requested tags
+  Bucket* oldest = nullptr;
+  unsigned long oldestSequence = 0;
+  for (int tag = 0; tag < buckets.size(); tag++) {
+    if ((tagMask & (1u << tag)) == 0) continue;
+    Bucket* bucket = &buckets[tag];
+    Entry* entry = bucket->front(sourceRank);
+    if (entry != nullptr && (oldest == nullptr || entry->sequence < oldestSequence)) {
+      oldest = bucket;
+      oldestSequence = entry->sequence;
+    }
+  }
+  if (oldest == nullptr) return nullptr;
+  count--;
+  return oldest->take(sourceRank);
+}
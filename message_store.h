@@ -0,0 +1,52 @@
+#ifndef MESSAGE_STORE_H_
+#define MESSAGE_STORE_H_
+
+#include <mpl/mpl.hpp>
+#include <vector>
+
+#include "ring_queue.h"
+
+struct MessageEnvelope;
+
+// Out-of-order messages indexed by (tag, source). Each tag keeps its entries
+// in arrival order and, per source, the entries that were not taken yet, so
+// both wildcard and exact lookups touch only queue fronts. The queues are
+// rings, so a store that has seen its deepest backlog allocates no more.
+class MessageStore {
+ private:
+  struct Entry {
+    unsigned long sequence;
+    const MessageEnvelope* envelope;
+    int source;
+    bool taken;
+  };
+
+  struct Bucket {
+    RingQueue<Entry> arrivals;
+    unsigned long firstArrival = 0;  // position of the front of arrivals
+    // positions of the entries not taken yet, the ring moves its entries
+    std::vector<RingQueue<unsigned long>> bySource;
+
+    Entry& at(unsigned long position) { return arrivals[position - firstArrival]; }
+    void dropTaken();
+    Entry* front(int sourceRank);
+    const MessageEnvelope* take(int sourceRank);
+  };
+
+  std::vector<Bucket> buckets;
+  unsigned long nextSequence = 0;
+  size_t count = 0;
+
+  Bucket* getBucket(mpl::tag tag);
+
+ public:
+  void push(const MessageEnvelope* envelope);
+  const MessageEnvelope* pop(int sourceRank, mpl::tag tag);
+  // tagMask has bit t set for every accepted tag t
+  const MessageEnvelope* pop(int sourceRank, unsigned tagMask);
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+};
+
+#endif  // MESSAGE_STORE_H_
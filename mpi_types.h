@@ -2,6 +2,7 @@
 #define MPI_TYPES_H_
 
 #include <mpl/mpl.hpp>
+#include <type_traits>
 
 enum MessageType {
   CONTRACTS,
@@ -10,15 +11,30 @@ enum MessageType {
   ALLOCATE_ARMOR,
   CONTRACT_COMPLETED,
   DELEGATE_PRIORITY,
-  SWAP
+  SWAP,
+  CREDIT
 };
 
-struct MessageBase {
+const int MESSAGE_TYPE_COUNT = CREDIT + 1;
+
+// Tag of a packed frame holding several messages for one destination
+const int FRAME = MESSAGE_TYPE_COUNT;
+
+// Round traffic is tagged type + epoch * EPOCH_STRIDE, so receives of one
+// round never match messages of another. Frames and credit messages keep
+// their bare tags, their order has to hold across rounds.
+const int EPOCH_STRIDE = FRAME + 1;
+
+// Every wire type starts with a header and holds nothing but ints, so it is
+// trivially copyable and maps onto a contiguous MPI datatype.
+struct MessageHeader {
   int timestamp;
-  virtual ~MessageBase() = default;
+  int credits;      // flow-control credits handed back to the recipient
+  int virtualTime;  // simulated milliseconds of the sender, see useVirtualTime
 };
 
-struct Contract : public MessageBase {
+struct Contract {
+  MessageHeader header;
   int contractId;
   int numberOfHamsters;
 
@@ -27,59 +43,193 @@ struct Contract : public MessageBase {
       : contractId(contractId), numberOfHamsters(numberOfHamsters) {}
 };
 
-struct RequestForContract : public MessageBase {
+struct RequestForContract {
+  MessageHeader header;
   int bloodHunger;
 
   RequestForContract() = default;
   RequestForContract(int bloodHunger) : bloodHunger(bloodHunger) {}
 
   bool operator<(const RequestForContract &rhs) const {
-    return (bloodHunger == rhs.bloodHunger) ? (timestamp < rhs.timestamp)
+    return (bloodHunger == rhs.bloodHunger) ? (header.timestamp < rhs.header.timestamp)
                                             : (bloodHunger > rhs.bloodHunger);
   }
 
   bool operator==(const RequestForContract &rhs) const {
-    return (bloodHunger == rhs.bloodHunger && timestamp == rhs.timestamp);
+    return (bloodHunger == rhs.bloodHunger && header.timestamp == rhs.header.timestamp);
   }
 };
 
-struct RequestForArmor : public MessageBase {
+struct RequestForArmor {
+  MessageHeader header;
   int contractId;
 
   RequestForArmor() = default;
   RequestForArmor(int contractId) : contractId(contractId) {}
 
   bool operator<(const RequestForArmor &rhs) const {
-    return timestamp < rhs.timestamp;
+    return header.timestamp < rhs.header.timestamp;
   }
 
   bool operator==(const RequestForArmor &rhs) const {
-    return timestamp == rhs.timestamp;
+    return header.timestamp == rhs.header.timestamp;
   }
 };
 
-struct AllocateArmor : public MessageBase {};
+struct AllocateArmor {
+  MessageHeader header;
+};
 
-struct DelegatePriority : public MessageBase {};
+struct DelegatePriority {
+  MessageHeader header;
+};
 
-struct ContractCompleted : public MessageBase {
+struct ContractCompleted {
+  MessageHeader header;
   int contractId;
 
   ContractCompleted() = default;
   ContractCompleted(int contractId) : contractId(contractId) {}
 };
 
-struct Swap : public MessageBase {
+struct Swap {
+  MessageHeader header;
   int delegatingRank;
   int delegatedRank;
+  // place of the delegated gnome in the armory queue, the delegating one
+  // moves back to it
+  int placeTimestamp;
+  int placeRank;
 
   Swap() = default;
-  Swap(int delegatingRank, int delegatedRank)
-      : delegatingRank(delegatingRank), delegatedRank(delegatedRank) {}
+  Swap(int delegatingRank, int delegatedRank, int placeTimestamp, int placeRank)
+      : delegatingRank(delegatingRank),
+        delegatedRank(delegatedRank),
+        placeTimestamp(placeTimestamp),
+        placeRank(placeRank) {}
+};
+
+// Hands back credits to a peer there is no other traffic to carry them to
+struct Credit {
+  MessageHeader header;
+};
+
+template <typename T>
+struct is_wire_type
+    : std::integral_constant<bool, std::is_standard_layout<T>::value &&
+                                       std::is_trivially_copyable<T>::value &&
+                                       sizeof(T) % sizeof(int) == 0> {};
+
+static_assert(is_wire_type<Contract>::value, "Contract is not a wire type");
+static_assert(is_wire_type<RequestForContract>::value, "RequestForContract is not a wire type");
+static_assert(is_wire_type<RequestForArmor>::value, "RequestForArmor is not a wire type");
+static_assert(is_wire_type<AllocateArmor>::value, "AllocateArmor is not a wire type");
+static_assert(is_wire_type<DelegatePriority>::value, "DelegatePriority is not a wire type");
+static_assert(is_wire_type<ContractCompleted>::value, "ContractCompleted is not a wire type");
+static_assert(is_wire_type<Swap>::value, "Swap is not a wire type");
+static_assert(is_wire_type<Credit>::value, "Credit is not a wire type");
+
+// Maps every tag onto the struct sent under it. Only single-struct messages
+// travel in envelopes, the contract list is a vector.
+template <MessageType type>
+struct MessageTraits;
+
+template <>
+struct MessageTraits<CONTRACTS> {
+  using type = Contract;
+  static constexpr bool inEnvelope = false;
+};
+
+template <>
+struct MessageTraits<REQUEST_FOR_CONTRACT> {
+  using type = RequestForContract;
+  static constexpr bool inEnvelope = true;
+};
+
+template <>
+struct MessageTraits<REQUEST_FOR_ARMOR> {
+  using type = RequestForArmor;
+  static constexpr bool inEnvelope = true;
+};
+
+template <>
+struct MessageTraits<ALLOCATE_ARMOR> {
+  using type = AllocateArmor;
+  static constexpr bool inEnvelope = true;
+};
+
+template <>
+struct MessageTraits<CONTRACT_COMPLETED> {
+  using type = ContractCompleted;
+  static constexpr bool inEnvelope = true;
+};
+
+template <>
+struct MessageTraits<DELEGATE_PRIORITY> {
+  using type = DelegatePriority;
+  static constexpr bool inEnvelope = true;
+};
+
+template <>
+struct MessageTraits<SWAP> {
+  using type = Swap;
+  static constexpr bool inEnvelope = true;
+};
+
+template <>
+struct MessageTraits<CREDIT> {
+  using type = Credit;
+  static constexpr bool inEnvelope = true;
+};
+
+// A received message of any point-to-point type, tagged with its type and the
+// status it arrived with. The payload is stored inline, so envelopes can be
+// copied around and buffered without knowing the concrete type.
+struct MessageEnvelope {
+  MessageType type;
+  int epoch;  // of the round it was sent in
+  mpl::status status;
+  std::aligned_union<0, RequestForContract, RequestForArmor, AllocateArmor,
+                     ContractCompleted, DelegatePriority, Swap, Credit>::type payload;
+
+  template <typename T>
+  T &get() {
+    static_assert(is_wire_type<T>::value, "envelope payload must be a wire type");
+    return *reinterpret_cast<T *>(&payload);
+  }
+
+  template <typename T>
+  const T &get() const {
+    static_assert(is_wire_type<T>::value, "envelope payload must be a wire type");
+    return *reinterpret_cast<const T *>(&payload);
+  }
+
+  // the header is the first member of every wire type
+  MessageHeader &header() { return *reinterpret_cast<MessageHeader *>(&payload); }
+
+  const MessageHeader &header() const {
+    return *reinterpret_cast<const MessageHeader *>(&payload);
+  }
 };
 
 namespace mpl {
 
+template <>
+class struct_builder<MessageHeader>
+    : public base_struct_builder<MessageHeader> {
+  struct_layout<MessageHeader> layout_;
+
+ public:
+  struct_builder() : base_struct_builder() {
+    MessageHeader str{};
+    layout_.register_struct(str);
+    layout_.register_element(str.timestamp);
+    layout_.register_element(str.credits);
+    layout_.register_element(str.virtualTime);
+    define_struct(layout_);
+  }
+};
+
 template <>
 class struct_builder<Contract>
     : public base_struct_builder<Contract> {
@@ -89,7 +239,7 @@ class struct_builder<Contract>
   struct_builder() : base_struct_builder() {
     Contract str;
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     layout_.register_element(str.contractId);
     layout_.register_element(str.numberOfHamsters);
     define_struct(layout_);
@@ -105,7 +255,7 @@ class struct_builder<RequestForContract>
   struct_builder() : base_struct_builder() {
     RequestForContract str;
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     layout_.register_element(str.bloodHunger);
     define_struct(layout_);
   }
@@ -120,7 +270,7 @@ class struct_builder<RequestForArmor>
   struct_builder() : base_struct_builder() {
     RequestForArmor str;
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     layout_.register_element(str.contractId);
     define_struct(layout_);
   }
@@ -135,7 +285,7 @@ class struct_builder<AllocateArmor>
   struct_builder() : base_struct_builder() {
     AllocateArmor str{};
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     define_struct(layout_);
   }
 };
@@ -149,7 +299,7 @@ class struct_builder<DelegatePriority>
   struct_builder() : base_struct_builder() {
     DelegatePriority str{};
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     define_struct(layout_);
   }
 };
@@ -163,7 +313,7 @@ class struct_builder<ContractCompleted>
   struct_builder() : base_struct_builder() {
     ContractCompleted str{};
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     layout_.register_element(str.contractId);
     define_struct(layout_);
   }
@@ -178,9 +328,25 @@ class struct_builder<Swap>
   struct_builder() : base_struct_builder() {
     Swap str{};
     layout_.register_struct(str);
-    layout_.register_element(str.timestamp);
+    layout_.register_element(str.header);
     layout_.register_element(str.delegatingRank);
     layout_.register_element(str.delegatedRank);
+    layout_.register_element(str.placeTimestamp);
+    layout_.register_element(str.placeRank);
+    define_struct(layout_);
+  }
+};
+
+template <>
+class struct_builder<Credit>
+    : public base_struct_builder<Credit> {
+  struct_layout<Credit> layout_;
+
+ public:
+  struct_builder() : base_struct_builder() {
+    Credit str{};
+    layout_.register_struct(str);
+    layout_.register_element(str.header);
     define_struct(layout_);
   }
 };
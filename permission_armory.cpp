@@ -0,0 +1,143 @@
+#include "permission_armory.h"
+
+bool PermissionArmory::enabled = false;
+
+PermissionArmory::PermissionArmory(const mpl::communicator& communicator, int swordsTotal,
+                                   int poisonTotal)
+    : communicator(communicator),
+      rank(communicator.rank()),
+      holdsPermission(communicator.size()),
+      deferred(communicator.size(), false),
+      foundShort(communicator.size(), false),
+      heldPermissions(0),
+      requesting(false),
+      requestClock(0),
+      highestClock(0),
+      isShort(false),
+      ledgerMayHaveChanged(true),
+      swords(swordsTotal),
+      poison(poisonTotal),
+      version(0) {
+  // the permission of a pair starts with its lower rank, a gnome's own is
+  // always its own
+  for (int other = 0; other < holdsPermission.size(); other++) {
+    holdsPermission[other] = rank <= other;
+    if (holdsPermission[other]) heldPermissions++;
+  }
+  responder = std::thread(&PermissionArmory::respondLoop, this);
+}
+
+PermissionArmory::~PermissionArmory() {
+  // past the barrier nobody asks for a permission anymore
+  communicator.barrier();
+  send(rank, STOP, 0);
+  responder.join();
+}
+
+void PermissionArmory::send(int recipientRank, Tag tag, int clock) {
+  Message message{clock, swords, poison, version, isShort};
+  communicator.send(message, recipientRank, mpl::tag(tag));
+  sentMessages++;
+}
+
+void PermissionArmory::givePermission(int otherRank) {
+  holdsPermission[otherRank] = false;
+  heldPermissions--;
+  send(otherRank, PERMISSION, 0);
+}
+
+bool PermissionArmory::hasPriority(int clock, int otherRank) const {
+  return requestClock < clock || (requestClock == clock && rank < otherRank);
+}
+
+void PermissionArmory::handleRequest(int sourceRank, int clock) {
+  highestClock = std::max(highestClock, clock);
+  // crossed a permission pushed to it
+  if (!holdsPermission[sourceRank]) return;
+  if (requesting && hasPriority(clock, sourceRank)) {
+    deferred[sourceRank] = true;
+    return;
+  }
+  givePermission(sourceRank);
+  // it goes first, and hands the permission back after
+  if (requesting) send(sourceRank, REQUEST, requestClock);
+}
+
+void PermissionArmory::handlePermission(int sourceRank, const Message& message) {
+  holdsPermission[sourceRank] = true;
+  heldPermissions++;
+  if (message[3] > version) {
+    swords = message[1];
+    poison = message[2];
+    version = message[3];
+    ledgerMayHaveChanged = true;
+  }
+}
+
+void PermissionArmory::respondLoop() {
+  Message message;
+  while (true) {
+    auto status = communicator.recv(message, mpl::any_source, mpl::tag::any());
+    if (status.tag() == mpl::tag(STOP)) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    foundShort[status.source()] = message[4];
+    if (status.tag() == mpl::tag(REQUEST)) {
+      handleRequest(status.source(), message[0]);
+    } else {
+      handlePermission(status.source(), message);
+      if (heldPermissions == holdsPermission.size()) permissionsArrived.notify_one();
+    }
+  }
+}
+
+std::unique_lock<std::mutex> PermissionArmory::lockLedger() {
+  std::unique_lock<std::mutex> lock(mutex);
+  requesting = true;
+  requestClock = ++highestClock;
+  for (int other = 0; other < holdsPermission.size(); other++) {
+    if (!holdsPermission[other]) send(other, REQUEST, requestClock);
+  }
+  permissionsArrived.wait(lock, [this] { return heldPermissions == holdsPermission.size(); });
+  return lock;
+}
+
+void PermissionArmory::unlockLedger(std::unique_lock<std::mutex>& lock) {
+  requesting = false;
+  for (int other = 0; other < deferred.size(); other++) {
+    if (!deferred[other]) continue;
+    deferred[other] = false;
+    givePermission(other);
+  }
+  lock.unlock();
+}
+
+bool PermissionArmory::tryAcquire(int swordsWanted, int poisonWanted) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    // still short until a newer ledger arrives
+    if (!ledgerMayHaveChanged) return false;
+  }
+  auto lock = lockLedger();
+  bool enough = swords >= swordsWanted && poison >= poisonWanted;
+  if (enough) {
+    swords -= swordsWanted;
+    poison -= poisonWanted;
+    version++;
+  }
+  isShort = !enough;
+  ledgerMayHaveChanged = enough;
+  unlockLedger(lock);
+  return enough;
+}
+
+void PermissionArmory::release(int swordsReturned, int poisonReturned) {
+  auto lock = lockLedger();
+  swords += swordsReturned;
+  poison += poisonReturned;
+  version++;
+  // this gnome holds every permission, so it can hand them out unasked
+  for (int other = 0; other < foundShort.size(); other++) {
+    if (foundShort[other]) deferred[other] = true;
+  }
+  unlockLedger(lock);
+}
@@ -0,0 +1,76 @@
+#ifndef PERMISSION_ARMORY_H_
+#define PERMISSION_ARMORY_H_
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mpl/mpl.hpp>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "armory.h"
+
+// Ricart-Agrawala mutual exclusion with the Roucairol-Carvalho optimization
+// over a ledger of the armory, on a private duplicate of the gnome
+// communicator. Each pair of gnomes shares one permission, and a gnome may
+// change the ledger while it holds all of its permissions. A permission
+// stays where it is until its other gnome asks for it, so a gnome taking
+// armor again only asks the ones that changed the ledger in between. The
+// ledger travels with every permission given away, and the copy with the
+// highest version is the latest one. A gnome that found the armory short
+// says so in its messages, and whoever returns armor next pushes it the
+// permission with the new ledger, so it retries once there is something new
+// instead of polling. A thread per gnome answers requests, so gnomes
+// blocked anywhere else still hand out their permissions.
+// Construction and destruction are collective.
+class PermissionArmory : public Armory {
+ private:
+  enum Tag { REQUEST, PERMISSION, STOP };
+  // clock, the ledger: swords, poison kits and its version, then whether the
+  // sender found the armory short
+  using Message = std::array<int, 5>;
+
+  mpl::communicator communicator;
+  const int rank;
+  std::mutex mutex;
+  std::condition_variable permissionsArrived;
+  std::vector<bool> holdsPermission;
+  std::vector<bool> deferred;  // requests answered once the ledger is done with
+  std::vector<bool> foundShort;  // as of the last message of each gnome
+  int heldPermissions;
+  bool requesting;
+  int requestClock;
+  int highestClock;
+  bool isShort;
+  bool ledgerMayHaveChanged;  // since the armory was last found short
+  int swords;
+  int poison;
+  int version;
+  std::atomic<unsigned long> sentMessages{0};
+  std::thread responder;
+
+  void send(int recipientRank, Tag tag, int clock);
+  void givePermission(int otherRank);
+  // whether the pending request of this gnome goes before the other one
+  bool hasPriority(int clock, int otherRank) const;
+  void handleRequest(int sourceRank, int clock);
+  void handlePermission(int sourceRank, const Message& message);
+  void respondLoop();
+  // returns holding the mutex, with every permission
+  std::unique_lock<std::mutex> lockLedger();
+  void unlockLedger(std::unique_lock<std::mutex>& lock);
+
+ public:
+  static bool enabled;
+
+  PermissionArmory(const mpl::communicator& communicator, int swordsTotal, int poisonTotal);
+  // waits until every gnome is done with the ledger
+  ~PermissionArmory() override;
+
+  bool tryAcquire(int swords, int poison) override;
+  void release(int swords, int poison) override;
+  unsigned long getSentMessages() const override { return sentMessages; }
+};
+
+#endif  // PERMISSION_ARMORY_H_
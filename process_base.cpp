@@ -1,97 +1,725 @@
 #include "process_base.h"
 
-#include "mpi_types.h"
+#include <cstring>
+
+namespace {
+
+using Receiver = mpl::status (*)(const mpl::communicator&, MessageEnvelope&, mpl::message&);
+
+// receives exactly the message a matched probe returned
+template <int type>
+mpl::status receiveAs(const mpl::communicator& communicator, MessageEnvelope& envelope,
+                      mpl::message& message) {
+  using T = typename MessageTraits<static_cast<MessageType>(type)>::type;
+  return communicator.mrecv(envelope.get<T>(), message);
+}
+
+template <int type>
+constexpr Receiver getReceiver() {
+  return MessageTraits<static_cast<MessageType>(type)>::inEnvelope ? &receiveAs<type> : nullptr;
+}
+
+template <size_t... I>
+constexpr std::array<Receiver, MESSAGE_TYPE_COUNT> makeReceivers(std::index_sequence<I...>) {
+  return {{getReceiver<I>()...}};
+}
+
+// typed receive for every tag, generated from MessageTraits
+constexpr auto receivers = makeReceivers(std::make_index_sequence<MESSAGE_TYPE_COUNT>{});
+
+using PersistentReceiver = mpl::prequest (*)(const mpl::communicator&, MessageEnvelope&, mpl::tag);
+
+template <int type>
+mpl::prequest receiveInitAs(const mpl::communicator& communicator, MessageEnvelope& slot,
+                            mpl::tag tag) {
+  using T = typename MessageTraits<static_cast<MessageType>(type)>::type;
+  return communicator.recv_init(slot.get<T>(), mpl::any_source, tag);
+}
+
+template <int type>
+constexpr PersistentReceiver getPersistentReceiver() {
+  return MessageTraits<static_cast<MessageType>(type)>::inEnvelope ? &receiveInitAs<type>
+                                                                   : nullptr;
+}
+
+template <size_t... I>
+constexpr std::array<PersistentReceiver, MESSAGE_TYPE_COUNT> makePersistentReceivers(
+    std::index_sequence<I...>) {
+  return {{getPersistentReceiver<I>()...}};
+}
+
+constexpr auto persistentReceivers =
+    makePersistentReceivers(std::make_index_sequence<MESSAGE_TYPE_COUNT>{});
+
+// a frame starts with the sender's epoch as a varint, then every record is
+// one tag byte followed by the raw wire struct
+template <size_t... I>
+constexpr std::array<size_t, MESSAGE_TYPE_COUNT> makePayloadSizes(std::index_sequence<I...>) {
+  return {{sizeof(typename MessageTraits<static_cast<MessageType>(I)>::type)...}};
+}
+
+constexpr auto payloadSizes = makePayloadSizes(std::make_index_sequence<MESSAGE_TYPE_COUNT>{});
+
+// receives a message of any tag as raw bytes, counted in bytes so a
+// message that is no whole number of elements still has a size
+std::vector<unsigned char> receiveBytes(const mpl::communicator& communicator,
+                                        mpl::message& message, const mpl::status& status) {
+  int count = status.get_count<unsigned char>();
+  std::vector<unsigned char> bytes(count);
+  communicator.mrecv(bytes.data(), mpl::vector_layout<unsigned char>(count), message);
+  return bytes;
+}
+
+using EnvelopeSender =
+    mpl::irequest (*)(const mpl::communicator&, const void*, int, mpl::tag, bool buffered);
+
+// sends the payload of a MessageEnvelope as the struct its type says
+template <int type>
+mpl::irequest sendEnvelopeAs(const mpl::communicator& communicator, const void* payload,
+                             int recipientRank, mpl::tag tag, bool buffered) {
+  using T = typename MessageTraits<static_cast<MessageType>(type)>::type;
+  const auto& message = static_cast<const MessageEnvelope*>(payload)->get<T>();
+  return buffered ? communicator.ibsend(message, recipientRank, tag)
+                  : communicator.isend(message, recipientRank, tag);
+}
+
+template <int type>
+constexpr EnvelopeSender getEnvelopeSender() {
+  return MessageTraits<static_cast<MessageType>(type)>::inEnvelope ? &sendEnvelopeAs<type>
+                                                                   : nullptr;
+}
+
+template <size_t... I>
+constexpr std::array<EnvelopeSender, MESSAGE_TYPE_COUNT> makeEnvelopeSenders(
+    std::index_sequence<I...>) {
+  return {{getEnvelopeSender<I>()...}};
+}
+
+constexpr auto envelopeSenders =
+    makeEnvelopeSenders(std::make_index_sequence<MESSAGE_TYPE_COUNT>{});
+
+const size_t progressQueueCapacity = 1024;
+// control messages per peer and round the send buffer has room for
+const size_t bufferedMessagesPerPeer = 2 * MESSAGE_TYPE_COUNT;
+const size_t bufferAlignment = 64;
+const size_t maxNeighborhoods = 64;
+// epochs between two sweeps for late messages in event loop mode
+const int sweepInterval = 8;
+
+mpl::status makeStatus(int source, int tag) {
+  MPI_Status status{};
+  status.MPI_SOURCE = source;
+  status.MPI_TAG = tag;
+  return *reinterpret_cast<mpl::status*>(&status);
+}
+
+}  // namespace
+
+bool ProcessBase::useEventLoop = false;
+int ProcessBase::maxFrameBytes = 0;
+bool ProcessBase::useProgressThread = false;
+bool ProcessBase::usePackedCodec = false;
+int ProcessBase::creditWindow = 0;
+bool ProcessBase::useBufferedSends = false;
+bool ProcessBase::useVirtualTime = false;
 
 ProcessBase::ProcessBase(const mpl::communicator& communicator, const char* tag)
-    : communicator(communicator), rank(communicator.rank()), role(tag) {
+    : epochCount(static_cast<int>(mpl::tag::up()) / EPOCH_STRIDE),
+      communicator(communicator),
+      rank(communicator.rank()),
+      role(tag),
+      logger(communicator.rank(), tag),
+      trace(communicator.rank(), tag),
+      incomingMessages(useProgressThread ? progressQueueCapacity : 1),
+      incomingVectors(useProgressThread ? progressQueueCapacity : 1),
+      outgoingMessages(useProgressThread ? progressQueueCapacity : 1),
+      codec(usePackedCodec ? communicator.size() : 0) {
   // initialize broadcast scope with all ranks
   broadcastScope.resize(communicator.size());
   std::iota(broadcastScope.begin(), broadcastScope.end(), 0);
+  if (usesFrames()) {
+    outgoingFrames.resize(communicator.size());
+    // room for one record past the limit, appendToFrame never goes further
+    frameBuffer.resize(WireCodec::maxVarintSize + maxFrameBytes + sizeof(MessageEnvelope));
+    frameBufferLayout.reset(new mpl::vector_layout<unsigned char>(frameBuffer.size()));
+  }
+  if (usesCredits()) {
+    sendCredits.resize(communicator.size(), creditWindow);
+    owedCredits.resize(communicator.size(), 0);
+    deferredSends.resize(communicator.size());
+  }
+  if (useBufferedSends) {
+    size_t messageBytes = usesFrames() ? frameBuffer.size() : sizeof(MessageEnvelope);
+    controlBufferBytes =
+        communicator.size() * bufferedMessagesPerPeer * getBufferSlot(messageBytes);
+    sendBuffer.resize(controlBufferBytes);
+    mpl::environment::buffer_attach(sendBuffer.data(), sendBuffer.size());
+  }
+  if (useProgressThread) {
+    progressThread = std::thread(&ProcessBase::progressLoop, this);
+  } else if (useEventLoop) {
+    startEventLoop();
+  }
 }
 
-void ProcessBase::setTimestamp(MessageBase& message) const {
-  message.timestamp = lamportClock;
+ProcessBase::~ProcessBase() {
+  waitForSends();
+  if (progressThread.joinable()) {
+    stopProgress = true;
+    progressThread.join();
+  }
+  if (!persistentReceives.empty()) {
+    persistentReceives.cancelall();
+    persistentReceives.waitall();
+  }
+  if (useBufferedSends) mpl::environment::buffer_detach();
+}
+
+void ProcessBase::startEventLoop() {
+  receiveSlots.reserve(2 * MESSAGE_TYPE_COUNT);
+  auto addSlots = [this](bool withCredit) {
+    for (int tag = 0; tag < MESSAGE_TYPE_COUNT; tag++) {
+      if (persistentReceivers[tag] == nullptr || (tag == CREDIT && !withCredit)) continue;
+      receiveSlots.emplace_back();
+      receiveSlots.back().type = static_cast<MessageType>(tag);
+    }
+  };
+  addSlots(true);
+  firstPreviousEpochSlot = receiveSlots.size();
+  // late messages of the previous round hold their senders' credits until
+  // they leave MPI, credits themselves carry no epoch
+  if (usesCredits()) addSlots(false);
+  armPersistentReceives();
+  completedIndices.resize(persistentReceives.size());
+}
+
+void ProcessBase::armPersistentReceives() {
+  persistentReceives = mpl::prequest_pool();
+  int previousEpoch = (epoch + epochCount - 1) % epochCount;
+  // slots never move again, so the requests can point into them
+  for (int slot = 0; slot < receiveSlots.size(); slot++) {
+    int type = receiveSlots[slot].type;
+    mpl::tag tag = slot < firstPreviousEpochSlot ? getWireTag(mpl::tag(type))
+                                                 : mpl::tag(type + previousEpoch * EPOCH_STRIDE);
+    persistentReceives.push(persistentReceivers[type](communicator, receiveSlots[slot], tag));
+  }
+  if (usesFrames()) {
+    persistentReceives.push(communicator.recv_init(frameBuffer.begin(), frameBuffer.end(),
+                                                   mpl::any_source, mpl::tag(FRAME)));
+  }
+  persistentReceives.startall();
+}
+
+void ProcessBase::completeReceive(int slot, const mpl::status& status) {
+  if (slot == receiveSlots.size()) {
+    unpackFrame(frameBuffer.data(), status.get_count<unsigned char>(), status.source(),
+                completedReceives);
+  } else {
+    completedReceives.push_back(receiveSlots[slot]);
+    completedReceives.back().epoch = getEpoch(status.tag());
+    completedReceives.back().status = status;
+  }
+}
+
+void ProcessBase::advanceEpoch() {
+  // whatever belongs to the old round leaves under its tags
+  flushDeferred();
+  flushFrames();
+  epoch = (epoch + 1) % epochCount;
+  if (persistentReceives.empty()) return;
+  // the receives are re-posted under the new tags, one that matched before
+  // the cancel went through holds a message like any other completion
+  persistentReceives.cancelall();
+  persistentReceives.waitall();
+  for (int slot = 0; slot < persistentReceives.size(); slot++) {
+    const auto& status = persistentReceives.get_status(slot);
+    if (!status.is_cancelled()) completeReceive(slot, status);
+  }
+  armPersistentReceives();
+  // a late message left in MPI would keep its sender's credit, and the
+  // sender may be blocked on a send deferred for the lack of it
+  if (usesCredits() || epoch % sweepInterval == 0) sweepStaleEpochs();
 }
 
-int ProcessBase::getTimestamp(const MessageBase& message) const {
-  return message.timestamp;
+void ProcessBase::sweepStaleEpochs() {
+  int previousEpoch = (epoch + epochCount - 1) % epochCount;
+  for (; sweptEpoch != epoch; sweptEpoch = (sweptEpoch + 1) % epochCount) {
+    for (int type = 0; type < MESSAGE_TYPE_COUNT; type++) {
+      if (receivers[type] == nullptr || type == CREDIT) continue;
+      mpl::tag tag(type + sweptEpoch * EPOCH_STRIDE);
+      auto probe = communicator.improbe(mpl::any_source, tag);
+      while (std::get<0>(probe)) {
+        // dropped on the way out, after their credits are settled
+        completedReceives.emplace_back();
+        auto& envelope = completedReceives.back();
+        envelope.type = static_cast<MessageType>(type);
+        envelope.epoch = sweptEpoch;
+        envelope.status = receivers[type](communicator, envelope, std::get<1>(probe));
+        probe = communicator.improbe(mpl::any_source, tag);
+      }
+    }
+  }
+  // stragglers of the previous round may still be on their way
+  sweptEpoch = previousEpoch;
+}
+
+bool ProcessBase::pollCompletions(bool blocking) {
+  if (useProgressThread) {
+    MessageEnvelope envelope;
+    bool received = false;
+    do {
+      while (incomingMessages.pop(envelope)) {
+        completedReceives.push_back(envelope);
+        received = true;
+      }
+      if (blocking && !received) std::this_thread::yield();
+    } while (blocking && !received);
+    return received;
+  }
+
+  int* last = blocking ? persistentReceives.waitsome(completedIndices.data())
+                       : persistentReceives.testsome(completedIndices.data());
+  int count = last - completedIndices.data();
+  auto firstNew = completedReceives.size();
+  for (int k = 0; k < count; k++) {
+    int slot = completedIndices[k];
+    // statuses come back in completion order, not slot order
+    completeReceive(slot, persistentReceives.get_status(k));
+    persistentReceives.start(slot);
+  }
+  // one wakeup can complete several tags at once, put them back in send
+  // order; few are new, and insertion sort is stable without scratch memory
+  for (size_t i = firstNew + 1; i < completedReceives.size(); i++) {
+    MessageEnvelope envelope = completedReceives[i];
+    int timestamp = envelope.header().timestamp;
+    size_t j = i;
+    for (; j > firstNew && completedReceives[j - 1].header().timestamp > timestamp; j--) {
+      completedReceives[j] = completedReceives[j - 1];
+    }
+    completedReceives[j] = envelope;
+  }
+  return count > 0;
+}
+
+const mpl::dist_graph_communicator& ProcessBase::getNeighborhood(
+    const mpl::communicator& group, const std::vector<int>& members) {
+  auto cached = neighborhoods.find(members);
+  if (cached != neighborhoods.end()) return *cached->second;
+  // every rank of group evicts at the same point, freeing is collective too
+  if (neighborhoods.size() == maxNeighborhoods) neighborhoods.clear();
+
+  mpl::dist_graph_communicator::source_set sources;
+  mpl::dist_graph_communicator::dest_set destinations;
+  if (std::find(members.begin(), members.end(), group.rank()) != members.end()) {
+    for (int member : members) {
+      if (member == group.rank()) continue;
+      sources.insert({member, 1});
+      destinations.insert({member, 1});
+    }
+  }
+  // no reordering, so neighbor ranks stay ranks in group
+  auto& neighborhood = neighborhoods[members];
+  neighborhood.reset(new mpl::dist_graph_communicator(group, sources, destinations, false));
+  return *neighborhood;
 }
 
 void ProcessBase::setBroadcastScope(std::vector<int> recipientRanks) {
   broadcastScope = recipientRanks;
 }
 
-void ProcessBase::storeInBuffer(const MessageBase* message, const mpl::status& status) {
-  messageBuffer.emplace_back(message, status);
+bool ProcessBase::isCompleted(SendHandle handle) {
+  if (handle <= completedSendHandle) return true;
+  flushFrames();
+  if (useProgressThread) {
+    // frames flushed above may carry messages of earlier handles
+    if (progressSentHandle < lastSendHandle) return false;
+    completedSendHandle = lastSendHandle;
+    return true;
+  }
+  if (!pendingSends.empty() && !pendingSends.testall()) return false;
+  // every posted send is done, release the pool and the payloads it used
+  pendingSends = mpl::irequest_pool();
+  pendingPayloads.clear();
+  completedSendHandle = lastSendHandle;
+  return true;
 }
 
-const MessageBase* ProcessBase::fetchFromBuffer(mpl::status& status, int sourceRank, const std::vector<mpl::tag>& tags) {
-  std::function<bool(std::pair<const MessageBase*, mpl::status>)> predicate;
-  if (sourceRank == mpl::any_source) {
-    predicate = [tags](std::pair<const MessageBase*, mpl::status> message) {
-      return std::find(tags.begin(), tags.end(), message.second.tag()) != tags.end();
-    };
+void ProcessBase::flushFrames() {
+  for (int recipientRank = 0; recipientRank < outgoingFrames.size(); recipientRank++) {
+    if (!outgoingFrames[recipientRank].empty()) sendFrame(recipientRank);
+  }
+}
+
+void ProcessBase::appendToFrame(int recipientRank, mpl::tag tag, const void* message,
+                                size_t size) {
+  auto& frame = outgoingFrames[recipientRank];
+  size_t recordSize = 1 + (usePackedCodec ? WireCodec::maxEncodedSize(size) : size);
+  if (!frame.empty() && frame.size() + recordSize > maxFrameBytes) sendFrame(recipientRank);
+  if (frame.empty()) WireCodec::putVarint(epoch, frame);
+  frame.push_back(static_cast<unsigned char>(static_cast<int>(tag)));
+  if (usePackedCodec) {
+    codec.encode(recipientRank, message, size, frame);
   } else {
-    predicate = [sourceRank, tags](std::pair<const MessageBase*, mpl::status> message) {
-      return (message.second.source() == sourceRank) &&
-             (std::find(tags.begin(), tags.end(), message.second.tag()) != tags.end());
-    };
-  }
-
-  auto iterator =
-      std::find_if(messageBuffer.begin(), messageBuffer.end(), predicate);
-  if (iterator == messageBuffer.end()) {
-    return nullptr;
-  }
-  auto message = iterator->first;
-  status = iterator->second;
-  messageBuffer.erase(iterator);
-  return message;
-}
-
-void ProcessBase::receiveMultiTag(
-    int sourceRank,
-    std::unordered_map<int, std::function<void(const MessageBase*, const mpl::status&)>> messageHandlers) {
-  std::vector<mpl::tag> tags(messageHandlers.size());
-  for (const auto& element : messageHandlers) {
-    tags.emplace_back((MessageType)element.first);
-  }
-  mpl::status status;
-  const MessageBase* bufferedMessage =
-      fetchFromBuffer(status, sourceRank, tags);
-  if (bufferedMessage != nullptr) {
-    int timestamp = getTimestamp(*bufferedMessage);
-    lamportClock = std::max(lamportClock, timestamp) + 1;
-    messageHandlers[(int)status.tag()](bufferedMessage, status);
-    delete (bufferedMessage);
+    auto bytes = static_cast<const unsigned char*>(message);
+    frame.insert(frame.end(), bytes, bytes + size);
+  }
+  coalescedMessages++;
+  // without coalescing the codec still sends every message on its own
+  if (maxFrameBytes == 0) sendFrame(recipientRank);
+}
+
+void ProcessBase::sendFrame(int recipientRank) {
+  auto& bytes = outgoingFrames[recipientRank];
+  size_t size = bytes.size();
+  sentFrameBytes += size;
+  const auto* layout = getFrameLayout(size);
+  std::shared_ptr<const void> payload =
+      std::make_shared<const Frame>(Frame{std::move(bytes), layout});
+  bytes.clear();
+  postSend(recipientRank, mpl::tag(FRAME), payload, &postFrame, size);
+  sentFrames++;
+}
+
+const mpl::vector_layout<unsigned char>* ProcessBase::getFrameLayout(size_t size) {
+  if (size >= frameLayouts.size()) frameLayouts.resize(size + 1);
+  if (!frameLayouts[size]) frameLayouts[size].reset(new mpl::vector_layout<unsigned char>(size));
+  return frameLayouts[size].get();
+}
+
+mpl::irequest ProcessBase::postFrame(const mpl::communicator& communicator, const void* payload,
+                                     int recipientRank, mpl::tag tag, bool buffered) {
+  const auto& frame = *static_cast<const Frame*>(payload);
+  return buffered ? communicator.ibsend(frame.bytes.data(), *frame.layout, recipientRank, tag)
+                  : communicator.isend(frame.bytes.data(), *frame.layout, recipientRank, tag);
+}
+
+void ProcessBase::postSend(int recipientRank, mpl::tag tag,
+                           const std::shared_ptr<const void>& payload, SendPoster post,
+                           size_t bytes) {
+  bool buffered = useBufferedSends && reserveSendBuffer(bytes);
+  tag = getWireTag(tag);
+  if (useProgressThread) {
+    OutgoingMessage message{recipientRank, tag, payload, post, buffered, ++lastSendHandle};
+    while (!outgoingMessages.push(std::move(message))) std::this_thread::yield();
+    return;
+  }
+  pendingSends.push(post(communicator, payload.get(), recipientRank, tag, buffered));
+  pendingPayloads.push_back(payload);
+}
+
+size_t ProcessBase::getBufferSlot(size_t bytes) {
+  // ints pack as they are, the rounding covers the allocator's alignment
+  return (bytes + MPI_BSEND_OVERHEAD + bufferAlignment - 1) / bufferAlignment * bufferAlignment;
+}
+
+bool ProcessBase::reserveSendBuffer(size_t bytes) {
+  size_t slot = getBufferSlot(bytes);
+  if (sendBufferUsed + slot > sendBuffer.size()) {
+    bufferFallbacks++;
+    return false;
+  }
+  sendBufferUsed += slot;
+  maxSendBufferUsed = std::max(maxSendBufferUsed, sendBufferUsed);
+  bufferedSends++;
+  return true;
+}
+
+void ProcessBase::recycleSendBuffer(size_t extraBytes) {
+  if (!useBufferedSends) return;
+  size_t size = std::max(sendBuffer.size(), controlBufferBytes + extraBytes);
+  if (sendBufferUsed == 0 && size == sendBuffer.size()) return;
+  // the progress thread must not post into the buffer while it is swapped
+  if (useProgressThread) {
+    while (progressPostedHandle < lastSendHandle) std::this_thread::yield();
+  } else if (!pendingSends.empty()) {
+    // MPI only hands back the space of buffered sends whose requests are done
+    pendingSends.waitall();
+    pendingSends = mpl::irequest_pool();
+    pendingPayloads.clear();
+    completedSendHandle = lastSendHandle;
+  }
+  // detaching waits until every buffered message has left
+  mpl::environment::buffer_detach();
+  sendBuffer.resize(size);
+  mpl::environment::buffer_attach(sendBuffer.data(), sendBuffer.size());
+  sendBufferUsed = 0;
+}
+
+void ProcessBase::queueEnvelope(int recipientRank, const MessageEnvelope& envelope) {
+  auto& deferred = deferredSends[recipientRank];
+  if (deferred.empty() && sendCredits[recipientRank] > 0) {
+    sendCredits[recipientRank]--;
+    sendEnvelope(recipientRank, envelope);
     return;
   }
+  deferred.push_back(envelope);
+  maxDeferredSends = std::max(maxDeferredSends, deferred.size());
+}
+
+void ProcessBase::sendEnvelope(int recipientRank, MessageEnvelope envelope) {
+  envelope.header().credits = owedCredits[recipientRank];
+  owedCredits[recipientRank] = 0;
+  mpl::tag tag(envelope.type);
+  if (usesFrames()) {
+    appendToFrame(recipientRank, tag, &envelope.payload, payloadSizes[envelope.type]);
+    return;
+  }
+  postSend(recipientRank, tag, std::make_shared<const MessageEnvelope>(envelope),
+           envelopeSenders[envelope.type], payloadSizes[envelope.type]);
+}
+
+void ProcessBase::sendDeferred(int recipientRank, bool force) {
+  auto& deferred = deferredSends[recipientRank];
+  while (!deferred.empty() && (force || sendCredits[recipientRank] > 0)) {
+    // a forced send overdraws, the credits it brings back repay it
+    sendCredits[recipientRank]--;
+    sendEnvelope(recipientRank, deferred.front());
+    deferred.pop_front();
+  }
+}
+
+void ProcessBase::flushDeferred() {
+  for (int recipientRank = 0; recipientRank < deferredSends.size(); recipientRank++) {
+    sendDeferred(recipientRank, true);
+  }
+}
+
+bool ProcessBase::settleCredits(const MessageEnvelope& envelope) {
+  int sourceRank = envelope.status.source();
+  bool isCredit = envelope.type == CREDIT;
+  sendCredits[sourceRank] += envelope.header().credits;
+  if (!isCredit) owedCredits[sourceRank]++;
+  sendDeferred(sourceRank, false);
+  // nothing left to carry the credits back, so they go on their own
+  if (owedCredits[sourceRank] >= (creditWindow + 1) / 2) {
+    Credit credit;
+    setTimestamp(credit);
+    sendEnvelope(sourceRank, makeEnvelope(credit, mpl::tag(CREDIT)));
+    creditMessages++;
+  }
+  // the peer may be blocked on what was just sent
+  if (usesFrames() && !outgoingFrames[sourceRank].empty()) sendFrame(sourceRank);
+  return isCredit;
+}
+
+void ProcessBase::progressLoop() {
+  mpl::irequest_pool sends;
+  std::vector<std::shared_ptr<const void>> payloads;
+  unsigned long postedHandle = 0;
+  RingQueue<MessageEnvelope> received;  // waits here while the queue is full
+  OutgoingMessage outgoing;
+
+  while (true) {
+    bool idle = true;
+    while (outgoingMessages.pop(outgoing)) {
+      sends.push(outgoing.post(communicator, outgoing.payload.get(), outgoing.recipientRank,
+                               outgoing.tag, outgoing.buffered));
+      payloads.push_back(std::move(outgoing.payload));
+      postedHandle = outgoing.handle;
+      progressPostedHandle = postedHandle;
+      idle = false;
+    }
+    if (sends.empty() || sends.testall()) {
+      sends = mpl::irequest_pool();
+      payloads.clear();
+      progressSentHandle = postedHandle;
+    }
+
+    auto probe = communicator.improbe(mpl::any_source, mpl::tag::any());
+    if (std::get<0>(probe)) {
+      idle = false;
+      const auto& status = std::get<2>(probe);
+      int type = getType(status.tag());
+      if (type == FRAME) {
+        receiveFrame(std::get<1>(probe), status, received);
+      } else if (receivers[type] != nullptr) {
+        received.emplace_back();
+        received.back().type = static_cast<MessageType>(type);
+        received.back().epoch = getEpoch(status.tag());
+        received.back().status =
+            receivers[type](communicator, received.back(), std::get<1>(probe));
+      } else {
+        VectorMessage vector{status, receiveBytes(communicator, std::get<1>(probe), status)};
+        while (!incomingVectors.push(std::move(vector))) std::this_thread::yield();
+      }
+    }
+    while (!received.empty() && incomingMessages.push(received.front())) {
+      received.pop_front();
+    }
+
+    if (idle) {
+      if (stopProgress && sends.empty()) break;
+      std::this_thread::yield();
+    }
+  }
+}
 
+ProcessBase::VectorMessage ProcessBase::awaitVector(int sourceRank, mpl::tag tag) {
+  tag = getWireTag(tag);
+  auto matches = [=](const VectorMessage& message) {
+    return (sourceRank == mpl::any_source || message.status.source() == sourceRank) &&
+           message.status.tag() == tag;
+  };
+  VectorMessage message;
+  auto buffered = std::find_if(receivedVectors.begin(), receivedVectors.end(), matches);
+  if (buffered != receivedVectors.end()) {
+    message = std::move(*buffered);
+    receivedVectors.erase(buffered);
+    return message;
+  }
   while (true) {
-    const auto& probe = communicator.probe(mpl::any_source, mpl::tag::any());
-    switch (static_cast<int>(probe.tag())) {
-      case REQUEST_FOR_CONTRACT:
-        if (receiveMultiTagHandle<RequestForContract>(sourceRank, probe.tag(), messageHandlers)) return;
-        break;
-      case REQUEST_FOR_ARMOR:
-        if (receiveMultiTagHandle<RequestForArmor>(sourceRank, probe.tag(), messageHandlers)) return;
-        break;
-      case ALLOCATE_ARMOR:
-        if (receiveMultiTagHandle<AllocateArmor>(sourceRank, probe.tag(), messageHandlers)) return;
-        break;
-      case CONTRACT_COMPLETED:
-        if (receiveMultiTagHandle<ContractCompleted>(sourceRank, probe.tag(), messageHandlers)) return;
-        break;
-      case DELEGATE_PRIORITY:
-        if (receiveMultiTagHandle<DelegatePriority>(sourceRank, probe.tag(), messageHandlers)) return;
-        break;
-      case SWAP:
-        if (receiveMultiTagHandle<Swap>(sourceRank, probe.tag(), messageHandlers)) return;
-        break;
-      default:
-        // Should never reach here
-        log("Received unexpected message. Committing suicide.");
-        return;
+    if (!incomingVectors.pop(message)) {
+      std::this_thread::yield();
+      continue;
+    }
+    if (matches(message)) return message;
+    receivedVectors.push_back(std::move(message));
+  }
+}
+
+void ProcessBase::receiveFrame(mpl::message& message, const mpl::status& status,
+                               RingQueue<MessageEnvelope>& received) {
+  int size = status.get_count<unsigned char>();
+  communicator.mrecv(frameBuffer.data(), *frameBufferLayout, message);
+  unpackFrame(frameBuffer.data(), size, status.source(), received);
+}
+
+void ProcessBase::unpackFrame(const unsigned char* frame, int size, int sourceRank,
+                              RingQueue<MessageEnvelope>& received) {
+  const unsigned char* records = frame;
+  int frameEpoch = WireCodec::getVarint(records);
+  for (int position = records - frame; position < size;) {
+    int tag = frame[position++];
+    received.emplace_back();
+    auto& envelope = received.back();
+    envelope.type = static_cast<MessageType>(tag);
+    envelope.epoch = frameEpoch;
+    envelope.status = makeStatus(sourceRank, tag);
+    if (usePackedCodec) {
+      position += codec.decode(sourceRank, frame + position, &envelope.payload, payloadSizes[tag]);
+    } else {
+      std::memcpy(&envelope.payload, frame + position, payloadSizes[tag]);
+      position += payloadSizes[tag];
     }
   }
 }
+
+void ProcessBase::waitForSends() {
+  flushDeferred();
+  flushFrames();
+  if (useProgressThread) {
+    while (progressSentHandle < lastSendHandle) std::this_thread::yield();
+    completedSendHandle = lastSendHandle;
+    return;
+  }
+  if (pendingSends.empty()) return;
+  pendingSends.waitall();
+  pendingSends = mpl::irequest_pool();
+  pendingPayloads.clear();
+  completedSendHandle = lastSendHandle;
+}
+
+void ProcessBase::logStatistics() const {
+  LOG(INFO, "Envelope pool went to the heap %zu times, %zu messages still buffered, %zu at most",
+      envelopePool.getChunkAllocations(), messageBuffer.size(), maxBufferedMessages);
+  if (useBufferedSends) {
+    LOG(INFO,
+        "Buffered %lu sends, %lu fell back to standard mode, at most %zu of %zu buffer bytes used",
+        bufferedSends, bufferFallbacks, maxSendBufferUsed, sendBuffer.size());
+  }
+  LOG(INFO, "Dropped %lu late messages of earlier rounds", staleMessages);
+  if (usesCredits()) {
+    LOG(INFO,
+        "Flow control window %d: %lu credit messages, at most %zu sends held back for one peer",
+        creditWindow, creditMessages, maxDeferredSends);
+  }
+  if (usesFrames()) {
+    LOG(INFO, "Sent %lu messages in %lu frames, %lu bytes", coalescedMessages, sentFrames,
+        sentFrameBytes);
+  }
+}
+
+void ProcessBase::storeInBuffer(const MessageEnvelope& envelope) {
+  traceEvent(TraceEvent::BUFFER, envelope.type, envelope.status.source());
+  messageBuffer.push(envelopePool.create(envelope));
+  maxBufferedMessages = std::max(maxBufferedMessages, messageBuffer.size());
+}
+
+const MessageEnvelope* ProcessBase::fetchFromBuffer(int sourceRank, unsigned tagMask) {
+  return messageBuffer.pop(sourceRank, tagMask);
+}
+
+void ProcessBase::releaseBuffered(const MessageEnvelope* envelope) {
+  envelopePool.destroy(envelope);
+}
+
+bool ProcessBase::receiveEnvelope(MessageEnvelope& envelope, bool blocking) {
+  while (nextEnvelope(envelope, blocking)) {
+    // every message leaving MPI frees a slot in its sender's window
+    if (usesCredits() && settleCredits(envelope)) continue;
+    if (envelope.epoch == epoch) return true;
+    traceEvent(TraceEvent::DROP, envelope.type, envelope.status.source());
+    staleMessages++;
+  }
+  return false;
+}
+
+bool ProcessBase::nextEnvelope(MessageEnvelope& envelope, bool blocking) {
+  while (completedReceives.empty()) {
+    if (useProgressThread || useEventLoop) {
+      if (!pollCompletions(blocking)) return false;
+      continue;
+    }
+    std::pair<mpl::message, mpl::status> probe;
+    if (blocking) {
+      probe = communicator.mprobe(mpl::any_source, mpl::tag::any());
+    } else {
+      auto polled = communicator.improbe(mpl::any_source, mpl::tag::any());
+      if (!std::get<0>(polled)) return false;
+      probe = {std::get<1>(polled), std::get<2>(polled)};
+    }
+    int type = getType(probe.second.tag());
+    if (type == FRAME) {
+      receiveFrame(probe.first, probe.second, completedReceives);
+      continue;
+    }
+    if (receivers[type] == nullptr) {
+      // Should never reach here
+      LOG(WARNING, "Received unexpected message. Committing suicide.");
+      return false;
+    }
+    envelope.type = static_cast<MessageType>(type);
+    envelope.epoch = getEpoch(probe.second.tag());
+    envelope.status = receivers[type](communicator, envelope, probe.first);
+    return true;
+  }
+  envelope = completedReceives.front();
+  completedReceives.pop_front();
+  return true;
+}
+
+bool ProcessBase::awaitEnvelope(int sourceRank, unsigned tagMask, MessageEnvelope& envelope,
+                                bool blocking) {
+  flushFrames();
+  const MessageEnvelope* bufferedMessage;
+  while ((bufferedMessage = fetchFromBuffer(sourceRank, tagMask)) != nullptr) {
+    bool current = bufferedMessage->epoch == epoch;
+    traceEvent(TraceEvent::UNBUFFER, bufferedMessage->type, bufferedMessage->status.source());
+    if (current) {
+      envelope = *bufferedMessage;
+    } else {
+      // buffered in a round that is over
+      traceEvent(TraceEvent::DROP, bufferedMessage->type, bufferedMessage->status.source());
+      staleMessages++;
+    }
+    releaseBuffered(bufferedMessage);
+    if (current) return true;
+  }
+  if (blocking) traceEvent(TraceEvent::WAIT, 0, sourceRank);
+  while (receiveEnvelope(envelope, blocking)) {
+    bool fromSource = sourceRank == mpl::any_source || envelope.status.source() == sourceRank;
+    if (fromSource && (tagMask & (1u << envelope.type))) return true;
+    storeInBuffer(envelope);
+  }
+  return false;
+}
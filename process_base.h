@@ -1,138 +1,501 @@
 #ifndef PROCESS_BASE_H_
 #define PROCESS_BASE_H_
 
+#include <array>
+#include <atomic>
 #include <cstdarg>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
 #include <mpl/mpl.hpp>
+#include <thread>
+
+#include "logger.h"
+#include "message_pool.h"
+#include "message_store.h"
+#include "mpi_types.h"
+#include "ring_queue.h"
+#include "spsc_queue.h"
+#include "trace.h"
+#include "wire_codec.h"
 
 #pragma GCC diagnostic ignored "-Wformat-security"  // for log function
 
-struct MessageBase;
+// Logs at level, a member of LogLevel, from a ProcessBase. Calls below
+// MIN_LOG_LEVEL compile to nothing, arguments included.
+#define LOG(level, ...)                                                      \
+  do {                                                                       \
+    if (LogLevel::level >= minLogLevel) log<LogLevel::level>(__VA_ARGS__); \
+  } while (0)
 
 class ProcessBase {
+ protected:
+  // Handlers of one state, indexed by tag. Tags without a handler are
+  // buffered until a state that handles them asks for them.
+  template <typename Process>
+  using HandlerTable =
+      std::array<void (Process::*)(const MessageEnvelope&), MESSAGE_TYPE_COUNT>;
+
  private:
   int lamportClock = 0;
+  int virtualTime = 0;  // simulated milliseconds, only spent with useVirtualTime
+  int epoch = 0;  // rounds started so far, wrapped within the tag space
+  const int epochCount;
+  int sweptEpoch = 0;  // oldest epoch the sweeper may still find messages of
+  unsigned long staleMessages = 0;
   const char* role;
+  mutable Logger logger;  // written from const methods too
+  TraceWriter trace;
+  int tracedState = -1;
   const mpl::communicator& communicator;
   std::vector<int> broadcastScope;
-  std::list<std::pair<const MessageBase*, mpl::status>> messageBuffer;
-
-  void setTimestamp(MessageBase& message) const;
-  int getTimestamp(const MessageBase& message) const;
-  void storeInBuffer(const MessageBase* message, const mpl::status& status);
-  const MessageBase* fetchFromBuffer(mpl::status& status, int sourceRank,
-                                     const std::vector<mpl::tag>& tags);
-
-  template <typename T>
-  bool receiveMultiTagHandle(
-      int sourceRank, mpl::tag tag,
-      std::unordered_map<int, std::function<void(const MessageBase*, const mpl::status&)>> messageHandlers) {
-    T message{};
-    const auto& status = communicator.recv(message, sourceRank, tag);
-    if (messageHandlers.find((int)status.tag()) != messageHandlers.end()) {
-      int timestamp = getTimestamp(message);
-      lamportClock = std::max(lamportClock, timestamp) + 1;
-      messageHandlers[(int)status.tag()](&message, status);
-      return true;
+  MessageStore messageBuffer;
+  MessagePool<MessageEnvelope> envelopePool;
+
+  // in-flight fan-out sends and the payloads they read from
+  mpl::irequest_pool pendingSends;
+  std::vector<std::shared_ptr<const void>> pendingPayloads;
+  unsigned long lastSendHandle = 0;
+  unsigned long completedSendHandle = 0;
+
+  // event loop mode: one persistent receive per tag into a pre-allocated slot
+  mpl::prequest_pool persistentReceives;
+  std::vector<MessageEnvelope> receiveSlots;
+  size_t firstPreviousEpochSlot = 0;  // the slots after it listen for the previous round
+  std::vector<int> completedIndices;
+  RingQueue<MessageEnvelope> completedReceives;
+
+  // coalescing: messages to one rank are packed into a frame until flushed
+  struct Frame {
+    std::vector<unsigned char> bytes;
+    const mpl::vector_layout<unsigned char>* layout;
+  };
+  std::vector<std::vector<unsigned char>> outgoingFrames;
+  std::vector<unsigned char> frameBuffer;
+  // committed datatypes by frame size, building one per frame costs more
+  // than sending it
+  std::vector<std::unique_ptr<mpl::vector_layout<unsigned char>>> frameLayouts;
+  std::unique_ptr<mpl::vector_layout<unsigned char>> frameBufferLayout;
+  unsigned long coalescedMessages = 0;
+  unsigned long sentFrames = 0;
+  unsigned long sentFrameBytes = 0;
+  WireCodec codec;
+
+  static bool usesFrames() { return maxFrameBytes > 0 || usePackedCodec; }
+
+  // progress thread mode: the thread owns every MPI receive and posts every
+  // send, the state machine only talks to it through these queues
+  using SendPoster =
+      mpl::irequest (*)(const mpl::communicator&, const void*, int, mpl::tag, bool buffered);
+  struct OutgoingMessage {
+    int recipientRank;
+    mpl::tag tag;
+    std::shared_ptr<const void> payload;
+    SendPoster post;
+    bool buffered;
+    unsigned long handle;
+  };
+  struct VectorMessage {
+    mpl::status status;
+    std::vector<unsigned char> bytes;
+  };
+  std::thread progressThread;
+  std::atomic<bool> stopProgress{false};
+  std::atomic<unsigned long> progressSentHandle{0};
+  std::atomic<unsigned long> progressPostedHandle{0};
+  SpscQueue<MessageEnvelope> incomingMessages;
+  SpscQueue<VectorMessage> incomingVectors;
+  SpscQueue<OutgoingMessage> outgoingMessages;
+  std::deque<VectorMessage> receivedVectors;
+
+  // buffered send mode: sends are copied into the attached buffer and complete
+  // at once, when it is full they fall back to standard mode
+  std::vector<char> sendBuffer;
+  size_t controlBufferBytes = 0;  // share for control messages, waves come on top
+  size_t sendBufferUsed = 0;
+  size_t maxSendBufferUsed = 0;
+  unsigned long bufferedSends = 0;
+  unsigned long bufferFallbacks = 0;
+
+  static size_t getBufferSlot(size_t bytes);
+  bool reserveSendBuffer(size_t bytes);
+  // waits until every buffered send has left and starts over with room for
+  // extraBytes on top of the control messages
+  void recycleSendBuffer(size_t extraBytes = 0);
+
+  // flow control: at most creditWindow messages to a peer that it has not
+  // taken out of MPI yet, later ones wait here in send order
+  std::vector<int> sendCredits;
+  std::vector<int> owedCredits;
+  std::vector<std::deque<MessageEnvelope>> deferredSends;
+  size_t maxDeferredSends = 0;
+  size_t maxBufferedMessages = 0;
+  unsigned long creditMessages = 0;
+
+  static bool usesCredits() { return creditWindow > 0; }
+
+  static int getType(mpl::tag wireTag) { return static_cast<int>(wireTag) % EPOCH_STRIDE; }
+  static int getEpoch(mpl::tag wireTag) { return static_cast<int>(wireTag) / EPOCH_STRIDE; }
+  mpl::tag getWireTag(mpl::tag tag) const {
+    int type = static_cast<int>(tag);
+    return type == FRAME || type == CREDIT ? tag : mpl::tag(type + epoch * EPOCH_STRIDE);
+  }
+
+  // neighborhoods built so far, keyed by their members
+  std::map<std::vector<int>, std::unique_ptr<mpl::dist_graph_communicator>> neighborhoods;
+
+  // credits are filled in per recipient when the message goes out
+  template <typename T /* wire type */>
+  void setTimestamp(T& message) const {
+    message.header = MessageHeader{lamportClock, 0, virtualTime};
+  }
+
+  template <typename T /* wire type */>
+  int getTimestamp(const T& message) const {
+    return message.header.timestamp;
+  }
+
+  // nothing is handled earlier in simulated time than it was sent
+  void observeVirtualTime(const MessageHeader& header) {
+    virtualTime = std::max(virtualTime, header.virtualTime);
+  }
+
+  void traceEvent(TraceEvent event, int detail = 0, int peer = -1) {
+    if (trace.isEnabled()) trace.record(event, detail, peer, lamportClock, epoch);
+  }
+
+  void traceBroadcast(mpl::tag tag) {
+    if (!trace.isEnabled()) return;
+    for (int recipientRank : broadcastScope) {
+      if (recipientRank != rank) traceEvent(TraceEvent::SEND, static_cast<int>(tag), recipientRank);
     }
-    storeInBuffer(new T(message), status);
-    return false;
   }
 
+  void startEventLoop();
+  void armPersistentReceives();
+  void completeReceive(int slot, const mpl::status& status);
+  // takes late messages of earlier epochs out of MPI in one pass
+  void sweepStaleEpochs();
+  bool pollCompletions(bool blocking);
+  // without blocking these return false as soon as nothing is left to take
+  bool receiveEnvelope(MessageEnvelope& envelope, bool blocking);
+  bool nextEnvelope(MessageEnvelope& envelope, bool blocking);
+  void receiveFrame(mpl::message& message, const mpl::status& status,
+                    RingQueue<MessageEnvelope>& received);
+  void unpackFrame(const unsigned char* frame, int size, int sourceRank,
+                   RingQueue<MessageEnvelope>& received);
+  void appendToFrame(int recipientRank, mpl::tag tag, const void* message, size_t size);
+  void sendFrame(int recipientRank);
+  const mpl::vector_layout<unsigned char>* getFrameLayout(size_t size);
+  static mpl::irequest postFrame(const mpl::communicator& communicator, const void* payload,
+                                 int recipientRank, mpl::tag tag, bool buffered);
+
+  template <typename T /* wire type */>
+  static mpl::irequest postSend(const mpl::communicator& communicator, const void* payload,
+                                int recipientRank, mpl::tag tag, bool buffered) {
+    const auto& message = *static_cast<const T*>(payload);
+    return buffered ? communicator.ibsend(message, recipientRank, tag)
+                    : communicator.isend(message, recipientRank, tag);
+  }
+
+  template <typename T /* wire type */>
+  static mpl::irequest postVectorSend(const mpl::communicator& communicator, const void* payload,
+                                      int recipientRank, mpl::tag tag, bool buffered) {
+    const auto& message = *static_cast<const std::vector<T>*>(payload);
+    mpl::vector_layout<T> layout(message.size());
+    return buffered ? communicator.ibsend(message.data(), layout, recipientRank, tag)
+                    : communicator.isend(message.data(), layout, recipientRank, tag);
+  }
+
+  // bytes is the size of the payload on the wire
+  void postSend(int recipientRank, mpl::tag tag, const std::shared_ptr<const void>& payload,
+                SendPoster post, size_t bytes);
+
+  template <typename T /* wire type */>
+  static MessageEnvelope makeEnvelope(const T& message, mpl::tag tag) {
+    MessageEnvelope envelope;
+    envelope.type = static_cast<MessageType>(static_cast<int>(tag));
+    envelope.get<T>() = message;
+    return envelope;
+  }
+
+  void queueEnvelope(int recipientRank, const MessageEnvelope& envelope);
+  void sendEnvelope(int recipientRank, MessageEnvelope envelope);
+  void sendDeferred(int recipientRank, bool force);
+  // returns true for credit messages, which are used up here
+  bool settleCredits(const MessageEnvelope& envelope);
+  void progressLoop();
+  VectorMessage awaitVector(int sourceRank, mpl::tag tag);
+  bool awaitEnvelope(int sourceRank, unsigned tagMask, MessageEnvelope& envelope,
+                     bool blocking = true);
+
  protected:
   const int rank;
 
+  using SendHandle = unsigned long;
+
   void setBroadcastScope(std::vector<int> recipientRanks);
+  void discard(const MessageEnvelope& envelope) {}
+  void logStatistics() const;
+  // messages that arrived before anybody asked for them
+  void storeInBuffer(const MessageEnvelope& envelope);
+  const MessageEnvelope* fetchFromBuffer(int sourceRank, unsigned tagMask);
+  void releaseBuffered(const MessageEnvelope* envelope);
+  bool isCompleted(SendHandle handle);
+  void waitForSends();
+  void flushFrames();
+  // sends what flow control held back regardless of credits, before blocking
+  // somewhere peers' credits cannot reach
+  void flushDeferred();
+  // call with the state about to run, only changes are traced
+  void traceState(int state) {
+    if (state == tracedState) return;
+    tracedState = state;
+    traceEvent(TraceEvent::STATE, state);
+  }
+  // Starts the next round: from here on only its messages are received, late
+  // ones of earlier rounds are dropped. Every rank must advance in step with
+  // the peers it exchanges round messages with.
+  void advanceEpoch();
+
+  int getVirtualTime() const { return virtualTime; }
+  // work that takes milliseconds of simulated time, done at once
+  void spendVirtualTime(int milliseconds) { virtualTime += milliseconds; }
 
-  template <typename... Args>
+  // for work done only to be logged
+  template <LogLevel level>
+  static bool isLogged() {
+    return level >= minLogLevel && level >= Logger::verbosity;
+  }
+
+  // use LOG, which also leaves out the arguments of compiled out levels
+  template <LogLevel level, typename... Args>
   void log(char const* const format, Args const&... args) const {
-    char buf[256];
-    auto len1 = sprintf(buf, "%c[%d;%dm [Rank: %2d] [Clock: %3d] [%s] ", 27, (1+(rank/7))%2, 31+(6+rank)%7, rank, lamportClock, role);
-    auto len2 = sprintf(buf+len1, format, args...);
-    sprintf(buf+len1+len2, "%c[%d;%dm\n", 27,0,37);
-    printf(buf);
-  }
-
-  template <typename T /* extends MessageBase */>
-  void flush(mpl::tag tag) {
-    T message;
-    auto probe = communicator.iprobe(mpl::any_source, tag);
-    while (probe.first) {
-      auto status = probe.second;
-      communicator.recv(message, status.source(), status.tag());
-      probe = communicator.iprobe(mpl::any_source, tag);
-    }
+    if (isLogged<level>()) logger.write(lamportClock, format, args...);
   }
 
-  template <typename T /* extends MessageBase */>
+  template <typename T /* wire type */>
   void send(T& message, int recipientRank, mpl::tag tag) {
     lamportClock++;
     setTimestamp(message);
-    communicator.send(message, recipientRank, tag);
+    traceEvent(TraceEvent::SEND, static_cast<int>(tag), recipientRank);
+    if (usesCredits()) {
+      queueEnvelope(recipientRank, makeEnvelope(message, tag));
+      return;
+    }
+    if (usesFrames()) {
+      appendToFrame(recipientRank, tag, &message, sizeof(T));
+      return;
+    }
+    if (useProgressThread || useBufferedSends) {
+      postSend(recipientRank, tag, std::make_shared<const T>(message), &postSend<T>, sizeof(T));
+      return;
+    }
+    communicator.send(message, recipientRank, getWireTag(tag));
   }
 
-  template <typename T /* extends MessageBase */>
-  void broadcast(T& message, mpl::tag tag) {
+  // Posts a nonblocking send to every rank in broadcast scope. The returned
+  // handle can be polled with isCompleted().
+  template <typename T /* wire type */>
+  SendHandle broadcast(T& message, mpl::tag tag) {
     lamportClock++;
     setTimestamp(message);
+    traceBroadcast(tag);
+    if (usesCredits()) {
+      auto envelope = makeEnvelope(message, tag);
+      for (int recipientRank : broadcastScope) {
+        if (recipientRank == rank) continue;
+        queueEnvelope(recipientRank, envelope);
+      }
+      return useProgressThread ? lastSendHandle : ++lastSendHandle;
+    }
+    if (usesFrames()) {
+      for (int recipientRank : broadcastScope) {
+        if (recipientRank == rank) continue;
+        appendToFrame(recipientRank, tag, &message, sizeof(T));
+      }
+      return useProgressThread ? lastSendHandle : ++lastSendHandle;
+    }
+    isCompleted(lastSendHandle);  // reclaim earlier fan-outs if they are done
+    std::shared_ptr<const void> payload = std::make_shared<const T>(message);
     for (int recipientRank : broadcastScope) {
       if (recipientRank == rank) continue;
-      communicator.send(message, recipientRank, tag);
+      postSend(recipientRank, tag, payload, &postSend<T>, sizeof(T));
     }
+    return useProgressThread ? lastSendHandle : ++lastSendHandle;
   }
 
-  template <typename T /* extends MessageBase */>
-  void broadcastVector(std::vector<T>& message, mpl::tag tag) {
+  template <typename T /* wire type */>
+  SendHandle broadcastVector(std::vector<T>& message, mpl::tag tag) {
+    size_t bytes = message.size() * sizeof(T);
+    recycleSendBuffer(getBufferSlot(bytes) * broadcastScope.size());
     lamportClock++;
     for (int i = 0; i < message.size(); i++) {
       setTimestamp(message[i]);
     }
+    traceBroadcast(tag);
+    isCompleted(lastSendHandle);
+    std::shared_ptr<const void> payload = std::make_shared<const std::vector<T>>(message);
     for (int recipientRank : broadcastScope) {
       if (recipientRank == rank) continue;
-      communicator.send(message.begin(), message.end(), recipientRank, tag);
+      postSend(recipientRank, tag, payload, &postVectorSend<T>, bytes);
     }
+    return useProgressThread ? lastSendHandle : ++lastSendHandle;
   }
 
-  template <typename T /* extends MessageBase */>
-  mpl::status receive(T& message, int sourceRank, mpl::tag tag) {
-    mpl::status status;
-    const MessageBase* bufferedMessage =
-        fetchFromBuffer(status, sourceRank, std::vector<mpl::tag>{tag});
-    if (bufferedMessage != nullptr) {
-      message = *static_cast<const T*>(bufferedMessage);
-      delete (bufferedMessage);
-    } else {
-      status = communicator.recv(message, sourceRank, tag);
+  // Lamport bookkeeping for data that is not passed as messages
+  template <typename T /* wire type */>
+  void stampOutgoing(std::vector<T>& message) {
+    lamportClock++;
+    for (auto& item : message) setTimestamp(item);
+    traceEvent(TraceEvent::CLOCK);
+  }
+
+  template <typename T /* wire type */>
+  void stampIncoming(const std::vector<T>& message) {
+    int timestamp = message.empty() ? lamportClock : getTimestamp(message[0]);
+    lamportClock = std::max(lamportClock, timestamp) + 1;
+    if (!message.empty()) observeVirtualTime(message[0].header);
+    traceEvent(TraceEvent::CLOCK);
+  }
+
+  // Graph communicator over group in which every member is a neighbor of every
+  // other member and the rest of group has no neighbors. members are ranks in
+  // group. Collective over group, and built once per distinct member set.
+  const mpl::dist_graph_communicator& getNeighborhood(const mpl::communicator& group,
+                                                      const std::vector<int>& members);
+
+  // Exchanges one message with every neighbor in a single collective.
+  // result is in the order of neighbor ranks in the neighborhood.
+  template <typename T /* wire type */>
+  void neighborAllgather(const mpl::dist_graph_communicator& neighborhood, T& message,
+                         std::vector<T>& result) {
+    flushDeferred();
+    flushFrames();
+    lamportClock++;
+    setTimestamp(message);
+    traceEvent(TraceEvent::WAIT);
+    result.resize(neighborhood.indegree());
+    neighborhood.neighbor_allgather(message, result.data());
+    for (const auto& item : result) {
+      lamportClock = std::max(lamportClock, getTimestamp(item));
+      observeVirtualTime(item.header);
+    }
+    lamportClock++;
+    traceEvent(TraceEvent::CLOCK);
+  }
+
+  // Exchanges one message with every member of group in a single collective.
+  // result is indexed by rank within group.
+  template <typename T /* wire type */>
+  void allgather(const mpl::communicator& group, T& message, std::vector<T>& result) {
+    flushDeferred();
+    flushFrames();
+    recycleSendBuffer();
+    lamportClock++;
+    setTimestamp(message);
+    traceEvent(TraceEvent::WAIT);
+    result.resize(group.size());
+    group.allgather(message, result.data());
+    for (const auto& item : result) {
+      lamportClock = std::max(lamportClock, getTimestamp(item));
+      observeVirtualTime(item.header);
     }
+    lamportClock++;
+    traceEvent(TraceEvent::CLOCK);
+  }
+
+  template <typename T /* wire type */>
+  mpl::status receive(T& message, int sourceRank, mpl::tag tag) {
+    MessageEnvelope envelope;
+    awaitEnvelope(sourceRank, 1u << static_cast<int>(tag), envelope);
+    message = envelope.get<T>();
     int timestamp = getTimestamp(message);
     lamportClock = std::max(lamportClock, timestamp) + 1;
-    return status;
+    observeVirtualTime(message.header);
+    traceEvent(TraceEvent::RECEIVE, envelope.type, envelope.status.source());
+    return envelope.status;
   }
 
-  template <typename T /* extends MessageBase */>
+  template <typename T /* wire type */>
   mpl::status receiveAny(T& message, mpl::tag tag) {
     return receive(message, mpl::any_source, tag);
   }
 
-  template <typename T /* extends MessageBase */>
+  // Receives straight into message, which only reallocates when a wave is
+  // larger than its capacity. An empty wave leaves message empty.
+  template <typename T /* wire type */>
   mpl::status receiveVector(std::vector<T>& message, int sourceRank, mpl::tag tag) {
-    const mpl::status& probe = communicator.probe(sourceRank, tag);
-    int size = probe.get_count<T>();
-    if ((size == mpl::undefined) || (size == 0)) exit(EXIT_FAILURE);
-    message.resize(size);
-    mpl::status status =
-        communicator.recv(message.begin(), message.end(), sourceRank, tag);
-    int timestamp = getTimestamp(message[0]);
+    flushDeferred();
+    flushFrames();
+    traceEvent(TraceEvent::WAIT, 0, sourceRank);
+    mpl::status status;
+    if (useProgressThread) {
+      VectorMessage received = awaitVector(sourceRank, tag);
+      if (received.bytes.size() % sizeof(T) != 0) {
+        LOG(WARNING, "Received a list that is not a whole number of elements. Ignoring it.");
+        message.clear();
+      } else {
+        message.resize(received.bytes.size() / sizeof(T));
+        std::memcpy(message.data(), received.bytes.data(), received.bytes.size());
+      }
+      status = received.status;
+    } else {
+      auto probe = communicator.mprobe(sourceRank, getWireTag(tag));
+      int size = probe.second.get_count<T>();
+      if (size == mpl::undefined) {
+        LOG(WARNING, "Received a list that is not a whole number of elements. Ignoring it.");
+        // received as bytes, which always fit, and thrown away
+        std::vector<unsigned char> bytes(probe.second.get_count<unsigned char>());
+        status = communicator.mrecv(bytes.data(), mpl::vector_layout<unsigned char>(bytes.size()),
+                                    probe.first);
+        message.clear();
+      } else {
+        message.resize(size);
+        status = communicator.mrecv(message.data(), mpl::vector_layout<T>(size), probe.first);
+      }
+    }
+    int timestamp = message.empty() ? lamportClock : getTimestamp(message[0]);
     lamportClock = std::max(lamportClock, timestamp) + 1;
+    if (!message.empty()) observeVirtualTime(message[0].header);
+    traceEvent(TraceEvent::RECEIVE, static_cast<int>(tag), status.source());
     return status;
   }
 
-  void receiveMultiTag(
-      int sourceRank,
-      std::unordered_map<int, std::function<void(const MessageBase*, const mpl::status&)>> messageHandlers);
+  // Returns false when there is nothing to handle, which without blocking
+  // means nothing handled has arrived yet.
+  template <typename Process>
+  bool receiveMultiTag(int sourceRank, const HandlerTable<Process>& handlers,
+                       bool blocking = true) {
+    unsigned tagMask = 0;
+    for (int tag = 0; tag < MESSAGE_TYPE_COUNT; tag++) {
+      if (handlers[tag] != nullptr) tagMask |= 1u << tag;
+    }
+    MessageEnvelope envelope;
+    if (!awaitEnvelope(sourceRank, tagMask, envelope, blocking)) return false;
+    int timestamp = envelope.header().timestamp;
+    lamportClock = std::max(lamportClock, timestamp) + 1;
+    observeVirtualTime(envelope.header());
+    traceEvent(TraceEvent::RECEIVE, envelope.type, envelope.status.source());
+    (static_cast<Process*>(this)->*handlers[envelope.type])(envelope);
+    return true;
+  }
 
  public:
   explicit ProcessBase(const mpl::communicator& communicator, const char* tag = "");
+  virtual ~ProcessBase();
   virtual void run(int maxRounds) = 0;
+
+  static bool useEventLoop;
+  static int maxFrameBytes;  // 0 sends every message on its own
+  static bool useProgressThread;
+  static bool usePackedCodec;
+  static int creditWindow;  // 0 turns flow control off
+  static bool useBufferedSends;
+  // Work costs simulated time carried on messages instead of sleeping, in the
+  // manner of conservative discrete-event simulation
+  static bool useVirtualTime;
 };
 
 #endif  // PROCESS_BASE_H_
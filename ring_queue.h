@@ -0,0 +1,51 @@
+#ifndef RING_QUEUE_H_
+#define RING_QUEUE_H_
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Single-threaded FIFO in a power-of-two ring that doubles when full and
+// never shrinks, so once it has grown to the deepest backlog pushing and
+// popping no longer touch the heap. Growing moves the items, pointers into
+// the queue do not survive a push.
+template <typename T>
+class RingQueue {
+ private:
+  std::vector<T> slots;
+  size_t head = 0;  // index of the front item in slots
+  size_t count = 0;
+
+  void grow() {
+    std::vector<T> larger(slots.empty() ? 16 : 2 * slots.size());
+    for (size_t i = 0; i < count; i++) larger[i] = std::move((*this)[i]);
+    slots.swap(larger);
+    head = 0;
+  }
+
+ public:
+  bool empty() const { return count == 0; }
+  size_t size() const { return count; }
+
+  T& operator[](size_t index) { return slots[(head + index) & (slots.size() - 1)]; }
+  const T& operator[](size_t index) const {
+    return slots[(head + index) & (slots.size() - 1)];
+  }
+  T& front() { return (*this)[0]; }
+  T& back() { return (*this)[count - 1]; }
+
+  void push_back(const T& item) {
+    if (count == slots.size()) grow();
+    (*this)[count++] = item;
+  }
+
+  // appends a value-initialized item to be filled in through back()
+  void emplace_back() { push_back(T{}); }
+
+  void pop_front() {
+    head = (head + 1) & (slots.size() - 1);
+    count--;
+  }
+};
+
+#endif  // RING_QUEUE_H_
@@ -0,0 +1,37 @@
+#include "rma_armory.h"
+
+bool RmaArmory::enabled = false;
+
+RmaArmory::RmaArmory(const mpl::communicator& communicator, int hostRank, int swordsTotal,
+                     int poisonTotal)
+    : hostRank(hostRank),
+      stock(pack(swordsTotal, poisonTotal)),
+      window(communicator, &stock, communicator.rank() == hostRank ? 1 : 0) {
+  // one passive-target epoch for the whole run, nobody ever locks exclusively
+  window.lock_all(MPI_MODE_NOCHECK);
+}
+
+RmaArmory::~RmaArmory() {
+  window.unlock_all();
+}
+
+std::int64_t RmaArmory::pack(int swords, int poison) {
+  return (static_cast<std::int64_t>(swords) << 32) | static_cast<std::uint32_t>(poison);
+}
+
+bool RmaArmory::tryAcquire(int swords, int poison) {
+  std::int64_t current =
+      window.fetch_and_op(std::int64_t(0), mpl::no_op<std::int64_t>(), hostRank);
+  while (true) {
+    int swordsAvailable = static_cast<int>(current >> 32);
+    int poisonAvailable = static_cast<int>(current & 0xffffffff);
+    if (swordsAvailable < swords || poisonAvailable < poison) return false;
+    std::int64_t seen = window.compare_and_swap(current - pack(swords, poison), current, hostRank);
+    if (seen == current) return true;
+    current = seen;  // somebody else got there first, retry with what they left
+  }
+}
+
+void RmaArmory::release(int swords, int poison) {
+  window.accumulate(pack(swords, poison), mpl::plus<std::int64_t>(), hostRank);
+}
@@ -0,0 +1,31 @@
+#ifndef RMA_ARMORY_H_
+#define RMA_ARMORY_H_
+
+#include <cstdint>
+#include <mpl/mpl.hpp>
+
+#include "armory.h"
+
+// The armory as one counter in an MPI window on the host rank: swords in
+// the high and poison kits in the low 32 bits, so a single compare-and-swap
+// takes both. Construction and destruction are collective.
+class RmaArmory : public Armory {
+ private:
+  const int hostRank;
+  std::int64_t stock;  // the counter itself, exposed only by the host
+  mpl::window window;
+
+  static std::int64_t pack(int swords, int poison);
+
+ public:
+  static bool enabled;
+
+  RmaArmory(const mpl::communicator& communicator, int hostRank, int swordsTotal,
+            int poisonTotal);
+  ~RmaArmory() override;
+
+  bool tryAcquire(int swords, int poison) override;
+  void release(int swords, int poison) override;
+};
+
+#endif  // RMA_ARMORY_H_
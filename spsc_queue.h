@@ -0,0 +1,54 @@
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class SpscQueue {
+ private:
+  std::vector<T> slots;
+  size_t mask;
+  std::atomic<size_t> head{0};  // next slot to pop, written by the consumer
+  char padding[64];             // keep head and tail on separate cache lines
+  std::atomic<size_t> tail{0};  // next slot to push, written by the producer
+
+  static size_t roundUp(size_t capacity) {
+    size_t size = 1;
+    while (size < capacity) size <<= 1;
+    return size;
+  }
+
+ public:
+  explicit SpscQueue(size_t capacity) : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+  bool push(T&& item) {
+    size_t position = tail.load(std::memory_order_relaxed);
+    if (position - head.load(std::memory_order_acquire) == slots.size()) return false;
+    slots[position & mask] = std::move(item);
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool push(const T& item) {
+    T copy(item);
+    return push(std::move(copy));
+  }
+
+  bool pop(T& item) {
+    size_t position = head.load(std::memory_order_relaxed);
+    if (position == tail.load(std::memory_order_acquire)) return false;
+    item = std::move(slots[position & mask]);
+    head.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+  }
+};
+
+#endif  // SPSC_QUEUE_H_
@@ -0,0 +1,67 @@
+#include "trace.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+
+std::string TraceWriter::filePrefix;
+
+// a multiple of the page and the record size, 64Ki records
+const size_t TraceWriter::windowBytes = 4096 * sizeof(TraceRecord) * 16;
+
+TraceWriter::TraceWriter(int rank, const char* role) {
+  if (filePrefix.empty()) return;
+  std::string path = filePrefix + std::to_string(rank) + ".trace";
+  file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (file < 0) {
+    fprintf(stderr, "[Rank: %2d] Cannot open %s, not tracing\n", rank, path.c_str());
+    return;
+  }
+  start = std::chrono::steady_clock::now();
+  mapWindow(0);
+  if (file < 0) return;
+  TraceHeader header{};
+  std::memcpy(header.magic, traceMagic, sizeof(header.magic));
+  header.version = traceVersion;
+  header.rank = rank;
+  std::strncpy(header.role, role, sizeof(header.role) - 1);
+  header.startTime = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                         std::chrono::system_clock::now().time_since_epoch())
+                         .count();
+  std::memcpy(window, &header, sizeof(header));
+  next += sizeof(header) / sizeof(TraceRecord);
+}
+
+TraceWriter::~TraceWriter() {
+  if (file < 0) return;
+  size_t written = next - reinterpret_cast<TraceRecord*>(window);
+  size_t size = windowOffset + written * sizeof(TraceRecord);
+  unmapWindow();
+  if (ftruncate(file, size) != 0) perror("trace");
+  close(file);
+}
+
+void TraceWriter::mapWindow(size_t offset) {
+  unmapWindow();
+  windowOffset = offset;
+  if (ftruncate(file, offset + windowBytes) != 0) perror("trace");
+  void* mapped = mmap(nullptr, windowBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, offset);
+  if (mapped == MAP_FAILED) {
+    // stops tracing, what is in the file so far stays there
+    perror("trace");
+    close(file);
+    file = -1;
+    return;
+  }
+  window = static_cast<char*>(mapped);
+  next = reinterpret_cast<TraceRecord*>(window);
+  end = next + windowBytes / sizeof(TraceRecord);
+}
+
+void TraceWriter::unmapWindow() {
+  if (window != nullptr) munmap(window, windowBytes);
+  window = nullptr;
+}
@@ -0,0 +1,83 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Binary event trace of one rank: a TraceHeader followed by TraceRecords, in
+// the order they happened on that rank. trace_tool reads and merges them.
+enum class TraceEvent : uint16_t {
+  SEND,      // detail is the message type, peer the recipient
+  RECEIVE,   // detail is the message type, peer the sender
+  BUFFER,    // received before anybody asked for it
+  UNBUFFER,  // taken back out of the buffer
+  STATE,     // detail is the new state of the role
+  CLOCK,     // Lamport clock moved without a point-to-point message
+  WAIT,      // about to block, until the rank's next event
+  DROP,      // late message of an earlier round thrown away
+  EVENT_COUNT
+};
+
+struct TraceRecord {
+  uint64_t time;  // nanoseconds since the trace started
+  int32_t clock;  // Lamport clock after the event
+  int32_t round;  // epoch of the rank, wrapped like message tags
+  int32_t peer;   // other rank, -1 for none or any
+  uint16_t event;
+  uint16_t detail;
+};
+
+struct TraceHeader {
+  char magic[8];
+  int32_t version;
+  int32_t rank;
+  char role[24];
+  uint64_t startTime;  // system clock nanoseconds, to line up the ranks
+};
+
+// records stay aligned to their size, so windows can start between any two
+static_assert(sizeof(TraceHeader) % sizeof(TraceRecord) == 0, "header must be whole records");
+
+const char traceMagic[8] = {'H', 'K', 'T', 'R', 'A', 'C', 'E', '\0'};
+const int traceVersion = 1;
+
+// Appends records to <filePrefix><rank>.trace through a sliding mmap window,
+// so recording one is a clock read and a store. Off when filePrefix is empty.
+class TraceWriter {
+ private:
+  static const size_t windowBytes;
+
+  int file = -1;
+  size_t windowOffset = 0;  // of the mapped window in the file
+  char* window = nullptr;
+  TraceRecord* next = nullptr;
+  TraceRecord* end = nullptr;
+  std::chrono::steady_clock::time_point start;
+
+  void mapWindow(size_t offset);
+  void unmapWindow();
+
+ public:
+  static std::string filePrefix;
+
+  TraceWriter(int rank, const char* role);
+  // cuts the file down to the records written
+  ~TraceWriter();
+
+  bool isEnabled() const { return file >= 0; }
+
+  void record(TraceEvent event, int detail, int peer, int clock, int round) {
+    if (next == end) {
+      mapWindow(windowOffset + windowBytes);
+      if (!isEnabled()) return;
+    }
+    auto time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start);
+    *next++ = TraceRecord{static_cast<uint64_t>(time.count()), clock, round, peer,
+                          static_cast<uint16_t>(event), static_cast<uint16_t>(detail)};
+  }
+};
+
+#endif  // TRACE_H_
@@ -0,0 +1,205 @@
+// Reads the traces written with -x, merges the ranks by Lamport clock and
+// prints message counts and wait times per round, per message type and per
+// rank. With --dump it also prints every event in merged order.
+// Usage: trace_tool [--dump] TRACE_FILE...
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "trace.h"
+
+namespace {
+
+// in the order of MessageType, GnomeState and LandlordState
+const char* const messageNames[] = {"CONTRACTS",          "REQUEST_FOR_CONTRACT",
+                                    "REQUEST_FOR_ARMOR",  "ALLOCATE_ARMOR",
+                                    "CONTRACT_COMPLETED", "DELEGATE_PRIORITY",
+                                    "SWAP",               "CREDIT"};
+const char* const gnomeStateNames[] = {"PEACE_IS_A_LIE",      "GATHER_PARTY", "TAKING_INVENTORY",
+                                       "DELEGATING_PRIORITY", "RAMPAGE",      "FINISH"};
+const char* const landlordStateNames[] = {"HIRE", "READ_GANDHI", "FINISH"};
+const char* const eventNames[] = {"SEND",  "RECEIVE", "BUFFER", "UNBUFFER",
+                                  "STATE", "CLOCK",   "WAIT",   "DROP"};
+
+const int messageTypeCount = sizeof(messageNames) / sizeof(messageNames[0]);
+
+template <size_t N>
+const char* getName(const char* const (&names)[N], int index) {
+  return index >= 0 && index < N ? names[index] : "?";
+}
+
+struct RankTrace {
+  TraceHeader header;
+  std::vector<TraceRecord> records;
+};
+
+struct Event {
+  int rank;
+  const TraceRecord* record;
+};
+
+struct RoundSummary {
+  unsigned long sends = 0;
+  unsigned long receives = 0;
+  unsigned long buffered = 0;
+  unsigned long dropped = 0;
+  double waitMilliseconds = 0;
+  double maxWaitMilliseconds = 0;
+  int maxWaitRank = -1;
+};
+
+struct RankSummary {
+  unsigned long events = 0;
+  unsigned long waits = 0;
+  double waitMilliseconds = 0;
+};
+
+bool readTrace(const char* path, RankTrace& trace) {
+  FILE* file = fopen(path, "rb");
+  if (file == nullptr) {
+    perror(path);
+    return false;
+  }
+  bool valid = fread(&trace.header, sizeof(trace.header), 1, file) == 1 &&
+               std::memcmp(trace.header.magic, traceMagic, sizeof(traceMagic)) == 0 &&
+               trace.header.version == traceVersion;
+  if (valid) {
+    TraceRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) trace.records.push_back(record);
+  } else {
+    fprintf(stderr, "%s: not a trace of version %d\n", path, traceVersion);
+  }
+  fclose(file);
+  return valid;
+}
+
+bool isGnome(const RankTrace& trace) {
+  return std::strcmp(trace.header.role, "GNOME") == 0;
+}
+
+const char* getDetailName(const RankTrace& trace, const TraceRecord& record) {
+  switch (static_cast<TraceEvent>(record.event)) {
+    case TraceEvent::STATE:
+      return isGnome(trace) ? getName(gnomeStateNames, record.detail)
+                            : getName(landlordStateNames, record.detail);
+    case TraceEvent::CLOCK:
+    case TraceEvent::WAIT:
+      return "";
+    default:
+      return getName(messageNames, record.detail);
+  }
+}
+
+void dump(const std::vector<Event>& events, const std::map<int, RankTrace>& traces) {
+  printf("%7s %4s %9s %6s %-9s %-22s %5s\n", "clock", "rank", "role", "round", "event", "detail",
+         "peer");
+  for (const auto& event : events) {
+    const auto& trace = traces.at(event.rank);
+    const auto& record = *event.record;
+    printf("%7d %4d %9s %6d %-9s %-22s %5d\n", record.clock, event.rank, trace.header.role,
+           record.round, getName(eventNames, record.event), getDetailName(trace, record),
+           record.peer);
+  }
+  printf("\n");
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  bool dumpEvents = false;
+  std::map<int, RankTrace> traces;
+  for (int i = 1; i < argc; i++) {
+    if (std::strcmp(argv[i], "--dump") == 0) {
+      dumpEvents = true;
+      continue;
+    }
+    RankTrace trace;
+    if (!readTrace(argv[i], trace)) return EXIT_FAILURE;
+    traces[trace.header.rank] = std::move(trace);
+  }
+  if (traces.empty()) {
+    fprintf(stderr, "usage: %s [--dump] TRACE_FILE...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  // causal order across ranks, program order within one
+  std::vector<Event> events;
+  for (const auto& trace : traces) {
+    for (const auto& record : trace.second.records) events.push_back(Event{trace.first, &record});
+  }
+  std::stable_sort(events.begin(), events.end(), [](const Event& lhs, const Event& rhs) {
+    if (lhs.record->clock != rhs.record->clock) return lhs.record->clock < rhs.record->clock;
+    return lhs.rank < rhs.rank;
+  });
+  if (dumpEvents) dump(events, traces);
+
+  std::map<int, RoundSummary> rounds;
+  std::map<int, RankSummary> ranks;
+  unsigned long sends[messageTypeCount] = {};
+  unsigned long receives[messageTypeCount] = {};
+  for (const auto& trace : traces) {
+    const auto& records = trace.second.records;
+    auto& rank = ranks[trace.first];
+    rank.events = records.size();
+    for (size_t i = 0; i < records.size(); i++) {
+      const auto& record = records[i];
+      auto& round = rounds[record.round];
+      switch (static_cast<TraceEvent>(record.event)) {
+        case TraceEvent::SEND:
+          round.sends++;
+          if (record.detail < messageTypeCount) sends[record.detail]++;
+          break;
+        case TraceEvent::RECEIVE:
+          round.receives++;
+          if (record.detail < messageTypeCount) receives[record.detail]++;
+          break;
+        case TraceEvent::BUFFER:
+          round.buffered++;
+          break;
+        case TraceEvent::DROP:
+          round.dropped++;
+          break;
+        case TraceEvent::WAIT: {
+          // the wait lasts until the rank does anything else
+          if (i + 1 == records.size()) break;
+          double waited = (records[i + 1].time - record.time) / 1e6;
+          round.waitMilliseconds += waited;
+          if (waited > round.maxWaitMilliseconds) {
+            round.maxWaitMilliseconds = waited;
+            round.maxWaitRank = trace.first;
+          }
+          rank.waits++;
+          rank.waitMilliseconds += waited;
+          break;
+        }
+        default:
+          break;
+      }
+    }
+  }
+
+  printf("%zu ranks, %zu events\n\n", traces.size(), events.size());
+  printf("%6s %8s %9s %9s %8s %12s %12s %9s\n", "round", "sends", "receives", "buffered",
+         "dropped", "wait ms", "max wait ms", "max rank");
+  for (const auto& round : rounds) {
+    const auto& summary = round.second;
+    printf("%6d %8lu %9lu %9lu %8lu %12.3f %12.3f %9d\n", round.first, summary.sends,
+           summary.receives, summary.buffered, summary.dropped, summary.waitMilliseconds,
+           summary.maxWaitMilliseconds, summary.maxWaitRank);
+  }
+  printf("\n%-22s %8s %9s\n", "message", "sends", "receives");
+  for (int type = 0; type < messageTypeCount; type++) {
+    if (sends[type] == 0 && receives[type] == 0) continue;
+    printf("%-22s %8lu %9lu\n", messageNames[type], sends[type], receives[type]);
+  }
+  printf("\n%4s %9s %8s %7s %12s\n", "rank", "role", "events", "waits", "wait ms");
+  for (const auto& rank : ranks) {
+    printf("%4d %9s %8lu %7lu %12.3f\n", rank.first, traces[rank.first].header.role,
+           rank.second.events, rank.second.waits, rank.second.waitMilliseconds);
+  }
+  return EXIT_SUCCESS;
+}
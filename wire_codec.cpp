@@ -0,0 +1,64 @@
+#include "wire_codec.h"
+
+#include <cstring>
+
+namespace {
+
+const int maxFields = 8;  // wire types are a handful of ints
+
+unsigned zigZag(int value) {
+  return (static_cast<unsigned>(value) << 1) ^ static_cast<unsigned>(value >> 31);
+}
+
+int unZigZag(unsigned value) {
+  return static_cast<int>(value >> 1) ^ -static_cast<int>(value & 1);
+}
+
+}  // namespace
+
+void WireCodec::putVarint(unsigned value, std::vector<unsigned char>& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<unsigned char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<unsigned char>(value));
+}
+
+unsigned WireCodec::getVarint(const unsigned char*& in) {
+  unsigned value = 0;
+  for (int shift = 0;; shift += 7) {
+    unsigned char byte = *in++;
+    value |= static_cast<unsigned>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return value;
+  }
+}
+
+WireCodec::WireCodec(int ranks) : lastSentClock(ranks, 0), lastReceivedClock(ranks, 0) {}
+
+size_t WireCodec::maxEncodedSize(size_t size) {
+  return size / sizeof(int) * 5;
+}
+
+void WireCodec::encode(int recipientRank, const void* message, size_t size,
+                       std::vector<unsigned char>& out) {
+  int fields[maxFields];
+  std::memcpy(fields, message, size);
+  // the header, and with it the timestamp, is the first member
+  putVarint(zigZag(fields[0] - lastSentClock[recipientRank]), out);
+  lastSentClock[recipientRank] = fields[0];
+  for (int i = 1; i < size / sizeof(int); i++) {
+    putVarint(zigZag(fields[i]), out);
+  }
+}
+
+size_t WireCodec::decode(int sourceRank, const unsigned char* in, void* message, size_t size) {
+  const unsigned char* start = in;
+  int fields[maxFields];
+  fields[0] = lastReceivedClock[sourceRank] + unZigZag(getVarint(in));
+  lastReceivedClock[sourceRank] = fields[0];
+  for (int i = 1; i < size / sizeof(int); i++) {
+    fields[i] = unZigZag(getVarint(in));
+  }
+  std::memcpy(message, fields, size);
+  return in - start;
+}
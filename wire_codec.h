@@ -0,0 +1,33 @@
+#ifndef WIRE_CODEC_H_
+#define WIRE_CODEC_H_
+
+#include <cstddef>
+#include <vector>
+
+// Packs wire types (a header followed by ints) into bytes: every int is a
+// zig-zag varint and the Lamport timestamp is sent as the difference to the
+// last timestamp exchanged with the same peer. Both ends must see a peer's
+// messages in the order they were encoded.
+class WireCodec {
+ private:
+  std::vector<int> lastSentClock;
+  std::vector<int> lastReceivedClock;
+
+ public:
+  explicit WireCodec(int ranks);
+
+  // upper bound of the encoded size of a message of size bytes
+  static size_t maxEncodedSize(size_t size);
+  static const size_t maxVarintSize = 5;
+
+  // plain varints, getVarint advances in past the bytes it read
+  static void putVarint(unsigned value, std::vector<unsigned char>& out);
+  static unsigned getVarint(const unsigned char*& in);
+
+  void encode(int recipientRank, const void* message, size_t size,
+              std::vector<unsigned char>& out);
+  // returns the number of bytes consumed from in
+  size_t decode(int sourceRank, const unsigned char* in, void* message, size_t size);
+};
+
+#endif  // WIRE_CODEC_H_